@@ -0,0 +1,491 @@
+/**
+ * @file bencode_bench.cpp
+ * @brief Bencode 解析 / 编码基准测试
+ *
+ * 语料（全部在内存中生成，sample.torrent 存在时一并加入）：
+ *   - sample.torrent
+ *   - 单文件 torrent：1k / 10k / 100k / 1M 个 piece
+ *   - 多文件 torrent：100k 个文件条目
+ *   - tracker 响应：compact 与字典两种 peer 模型
+ *   - 扩展协议消息：扩展握手、ut_metadata data（字典头 + 16 KiB 负载）
+ *
+ * 对每个文档测量：
+ *   - decode    : decode_bencoded_value() 解码为 nlohmann::json
+ *   - arena     : BencodeValue::parse() 解码到复用的 BencodeArena
+ *   - info_span : TorrentMeta::parse() 取出 info 字典原始区间（仅 torrent）
+ *   - encode    : bencode_encode() 把 decode 的结果重新编码
+ *
+ * 每条记录包含 MB/s、cycles/byte，以及单次调用的堆分配次数、分配字节数和
+ * 峰值堆占用（全局 operator new/delete 计数）；报告末尾附进程最大 RSS。
+ *
+ * 用法:
+ *   bencode_bench [--min-time <seconds>] [--max-pieces <n>] [--sample <torrent>] [-o <output.json>]
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <new>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include <sys/resource.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCODE_BENCH_HAVE_TSC 1
+#else
+#define BENCODE_BENCH_HAVE_TSC 0
+#endif
+
+#ifndef BENCODE_BENCH_SAMPLE
+#define BENCODE_BENCH_SAMPLE "sample.torrent"
+#endif
+
+#include "lib/nlohmann/json.hpp"
+#include "bencode.hpp"
+#include "torrent.hpp"
+
+using json = nlohmann::json;
+
+// ============================================================================
+// 堆分配计数
+// ============================================================================
+
+namespace
+{
+
+struct HeapCounters
+{
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    int64_t live = 0;   // 当前未释放的字节数
+    int64_t peak = 0;   // live 的最大值（measure_heap() 开始时重置为当前 live）
+};
+
+HeapCounters heap;
+
+/**
+ * @brief 在块前放一个记录大小的头部，释放时据此更新 live
+ *
+ * 头部长度取 max(align, 16)，保证返回的指针满足请求的对齐。
+ */
+void* counted_alloc(size_t size, size_t align)
+{
+    size_t header = std::max<size_t>(align, 16);
+    void* base = nullptr;
+    if (posix_memalign(&base, header, header + size) != 0) throw std::bad_alloc();
+    char* p = static_cast<char*>(base) + header;
+    std::memcpy(p - sizeof(size_t), &size, sizeof(size_t));
+
+    heap.allocations++;
+    heap.bytes += size;
+    heap.live += static_cast<int64_t>(size);
+    if (heap.live > heap.peak) heap.peak = heap.live;
+    return p;
+}
+
+void counted_free(void* ptr, size_t align)
+{
+    if (ptr == nullptr) return;
+    size_t header = std::max<size_t>(align, 16);
+    char* p = static_cast<char*>(ptr);
+    size_t size = 0;
+    std::memcpy(&size, p - sizeof(size_t), sizeof(size_t));
+    heap.live -= static_cast<int64_t>(size);
+    std::free(p - header);
+}
+
+} // namespace
+
+void* operator new(size_t size) { return counted_alloc(size, 16); }
+void* operator new[](size_t size) { return counted_alloc(size, 16); }
+void* operator new(size_t size, std::align_val_t align) { return counted_alloc(size, static_cast<size_t>(align)); }
+void* operator new[](size_t size, std::align_val_t align) { return counted_alloc(size, static_cast<size_t>(align)); }
+void operator delete(void* ptr) noexcept { counted_free(ptr, 16); }
+void operator delete[](void* ptr) noexcept { counted_free(ptr, 16); }
+void operator delete(void* ptr, size_t) noexcept { counted_free(ptr, 16); }
+void operator delete[](void* ptr, size_t) noexcept { counted_free(ptr, 16); }
+void operator delete(void* ptr, std::align_val_t align) noexcept { counted_free(ptr, static_cast<size_t>(align)); }
+void operator delete[](void* ptr, std::align_val_t align) noexcept { counted_free(ptr, static_cast<size_t>(align)); }
+void operator delete(void* ptr, size_t, std::align_val_t align) noexcept { counted_free(ptr, static_cast<size_t>(align)); }
+void operator delete[](void* ptr, size_t, std::align_val_t align) noexcept { counted_free(ptr, static_cast<size_t>(align)); }
+
+namespace
+{
+
+// ============================================================================
+// 计时
+// ============================================================================
+
+struct BenchOptions
+{
+    double min_time = 0.25;                 // 每项至少运行的秒数
+    size_t max_pieces = 1000000;            // 合成 torrent 的最大 piece 数
+    std::string sample_path = BENCODE_BENCH_SAMPLE;
+    std::string output_path;                // 空 = stdout
+};
+
+struct Measurement
+{
+    uint64_t iterations = 0;
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+    uint64_t cycles = 0;
+};
+
+/**
+ * @brief 单次调用的堆使用情况
+ */
+struct HeapUsage
+{
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    int64_t peak = 0;       // 调用期间相对调用前多占用的最大字节数
+};
+
+uint64_t read_tsc()
+{
+#if BENCODE_BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief 反复执行 fn（每次处理 bytes_per_call 字节），直到累计时间不少于 min_time
+ */
+Measurement run_timed(const std::function<void()>& fn, uint64_t bytes_per_call, double min_time)
+{
+    fn(); // 预热
+
+    Measurement m;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t tsc_start = read_tsc();
+    while (true)
+    {
+        fn();
+        m.iterations++;
+        m.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (m.seconds >= min_time) break;
+    }
+    m.cycles = read_tsc() - tsc_start;
+    m.bytes = m.iterations * bytes_per_call;
+    return m;
+}
+
+/**
+ * @brief 执行一次 fn 并记录期间的堆分配
+ */
+HeapUsage measure_heap(const std::function<void()>& fn)
+{
+    HeapCounters before = heap;
+    heap.peak = heap.live;
+    fn();
+    HeapUsage usage;
+    usage.allocations = heap.allocations - before.allocations;
+    usage.bytes = heap.bytes - before.bytes;
+    usage.peak = heap.peak - before.live;
+    heap.peak = std::max(heap.peak, before.peak);
+    return usage;
+}
+
+json make_record(const std::string& op, const std::string& doc, size_t size, const Measurement& m,
+                 const HeapUsage& usage)
+{
+    json r;
+    r["op"] = op;
+    r["doc"] = doc;
+    r["size"] = size;
+    r["iterations"] = m.iterations;
+    r["bytes"] = m.bytes;
+    r["seconds"] = m.seconds;
+    r["mb_per_s"] = m.seconds > 0 ? static_cast<double>(m.bytes) / 1e6 / m.seconds : 0.0;
+    if (BENCODE_BENCH_HAVE_TSC && m.bytes > 0)
+    {
+        r["cycles_per_byte"] = static_cast<double>(m.cycles) / static_cast<double>(m.bytes);
+    }
+    else
+    {
+        r["cycles_per_byte"] = nullptr;
+    }
+    r["allocations"] = usage.allocations;
+    r["allocated_bytes"] = usage.bytes;
+    r["peak_heap_bytes"] = usage.peak;
+    return r;
+}
+
+// ============================================================================
+// 语料
+// ============================================================================
+
+struct Document
+{
+    std::string name;
+    std::string data;
+    bool is_torrent = false;
+};
+
+std::string random_bytes(std::mt19937_64& rng, size_t n)
+{
+    std::string s(n, '\0');
+    for (size_t i = 0; i < n; i += 8)
+    {
+        uint64_t v = rng();
+        std::memcpy(&s[i], &v, std::min<size_t>(8, n - i));
+    }
+    return s;
+}
+
+json torrent_skeleton(const std::string& name, int64_t piece_length)
+{
+    json torrent;
+    torrent["announce"] = "http://tracker.example.com:6969/announce";
+    torrent["created by"] = "bencode_bench";
+    torrent["creation date"] = 1700000000;
+    torrent["info"]["name"] = name;
+    torrent["info"]["piece length"] = piece_length;
+    return torrent;
+}
+
+Document single_file_torrent(std::mt19937_64& rng, size_t pieces)
+{
+    const int64_t piece_length = 256 * 1024;
+    json torrent = torrent_skeleton("single.bin", piece_length);
+    torrent["info"]["length"] = static_cast<int64_t>(pieces) * piece_length;
+    torrent["info"]["pieces"] = random_bytes(rng, pieces * 20);
+    return {"torrent_" + std::to_string(pieces) + "_pieces", bencode_encode(torrent), true};
+}
+
+Document multi_file_torrent(std::mt19937_64& rng, size_t files)
+{
+    const int64_t piece_length = 1024 * 1024;
+    json torrent = torrent_skeleton("multi", piece_length);
+    json list = json::array();
+    int64_t total = 0;
+    for (size_t i = 0; i < files; i++)
+    {
+        int64_t length = static_cast<int64_t>(rng() % (4 * 1024 * 1024));
+        total += length;
+        json entry;
+        entry["length"] = length;
+        entry["path"] = json::array({"dir" + std::to_string(i / 1000), "file_" + std::to_string(i) + ".dat"});
+        list.push_back(std::move(entry));
+    }
+    torrent["info"]["files"] = std::move(list);
+    size_t pieces = static_cast<size_t>((total + piece_length - 1) / piece_length);
+    torrent["info"]["pieces"] = random_bytes(rng, pieces * 20);
+    return {"torrent_" + std::to_string(files) + "_files", bencode_encode(torrent), true};
+}
+
+Document tracker_compact(std::mt19937_64& rng, size_t peers)
+{
+    json reply;
+    reply["complete"] = 120;
+    reply["incomplete"] = 8;
+    reply["interval"] = 1800;
+    reply["min interval"] = 60;
+    reply["peers"] = random_bytes(rng, peers * 6);
+    return {"tracker_compact_" + std::to_string(peers), bencode_encode(reply), false};
+}
+
+Document tracker_dict(std::mt19937_64& rng, size_t peers)
+{
+    json reply;
+    reply["interval"] = 1800;
+    json list = json::array();
+    for (size_t i = 0; i < peers; i++)
+    {
+        json peer;
+        peer["ip"] = "10." + std::to_string(rng() % 256) + "." + std::to_string(rng() % 256) + "." +
+                     std::to_string(rng() % 256);
+        peer["peer id"] = random_bytes(rng, 20);
+        peer["port"] = static_cast<int64_t>(6881 + rng() % 100);
+        list.push_back(std::move(peer));
+    }
+    reply["peers"] = std::move(list);
+    return {"tracker_dict_" + std::to_string(peers), bencode_encode(reply), false};
+}
+
+Document extension_handshake()
+{
+    json handshake;
+    handshake["m"]["ut_metadata"] = 3;
+    handshake["m"]["ut_pex"] = 1;
+    handshake["m"]["ut_holepunch"] = 4;
+    handshake["metadata_size"] = 31235;
+    handshake["p"] = 6881;
+    handshake["reqq"] = 250;
+    handshake["v"] = "bencode_bench 1.0";
+    handshake["yourip"] = std::string("\x7f\x00\x00\x01", 4);
+    return {"ext_handshake", bencode_encode(handshake), false};
+}
+
+/**
+ * @brief ut_metadata data 消息：字典头之后紧跟 16 KiB metadata 片段
+ */
+Document metadata_data(std::mt19937_64& rng)
+{
+    json header;
+    header["msg_type"] = 1;
+    header["piece"] = 0;
+    header["total_size"] = 31235;
+    return {"ut_metadata_data", bencode_encode(header) + random_bytes(rng, 16 * 1024), false};
+}
+
+std::vector<Document> build_corpus(const BenchOptions& opt)
+{
+    std::vector<Document> corpus;
+
+    std::ifstream in(opt.sample_path, std::ios::binary);
+    if (in)
+    {
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        corpus.push_back({"sample.torrent", buffer.str(), true});
+    }
+    else
+    {
+        std::cerr << "Sample torrent not found, skipping: " << opt.sample_path << std::endl;
+    }
+
+    std::mt19937_64 rng(42);
+    for (size_t pieces = 1000; pieces <= opt.max_pieces; pieces *= 10)
+    {
+        corpus.push_back(single_file_torrent(rng, pieces));
+    }
+    corpus.push_back(multi_file_torrent(rng, 100000));
+    corpus.push_back(tracker_compact(rng, 50));
+    corpus.push_back(tracker_compact(rng, 1000));
+    corpus.push_back(tracker_dict(rng, 50));
+    corpus.push_back(extension_handshake());
+    corpus.push_back(metadata_data(rng));
+    return corpus;
+}
+
+BenchOptions parse_options(int argc, char* argv[])
+{
+    BenchOptions opt;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+        if (arg == "--min-time") opt.min_time = std::stod(argv[++i]);
+        else if (arg == "--max-pieces") opt.max_pieces = static_cast<size_t>(std::stoull(argv[++i]));
+        else if (arg == "--sample") opt.sample_path = argv[++i];
+        else if (arg == "-o") opt.output_path = argv[++i];
+        else throw std::runtime_error("Unknown option: " + arg);
+    }
+    return opt;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    BenchOptions opt;
+    try
+    {
+        opt = parse_options(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << "Usage: " << argv[0]
+                  << " [--min-time <seconds>] [--max-pieces <n>] [--sample <torrent>] [-o <output.json>]" << std::endl;
+        return 1;
+    }
+
+    std::vector<Document> corpus = build_corpus(opt);
+    json results = json::array();
+
+    for (const Document& doc : corpus)
+    {
+        // ut_metadata data 消息在字典之后还有负载，按消息的处理方式只解码字典头；
+        // 吞吐量按解析器实际消耗的字节计
+        size_t consumed = 0;
+        auto decode = [&]() {
+            size_t pos = 0;
+            json value = decode_bencoded_value(doc.data, pos);
+            consumed = pos;
+            return value;
+        };
+
+        HeapUsage usage = measure_heap([&]() { (void)decode(); });
+        Measurement m = run_timed([&]() { (void)decode(); }, consumed, opt.min_time);
+        results.push_back(make_record("decode", doc.name, consumed, m, usage));
+
+        // arena 在迭代间复用：第二次 reset() 把预热时的多个块合并为一块之后，
+        // 解析不再向堆申请内存
+        BencodeArena arena;
+        auto parse_arena = [&]() {
+            arena.reset();
+            size_t pos = 0;
+            (void)BencodeValue::parse(doc.data, pos, arena);
+        };
+        parse_arena();
+        parse_arena();
+        usage = measure_heap(parse_arena);
+        m = run_timed(parse_arena, consumed, opt.min_time);
+        results.push_back(make_record("arena", doc.name, consumed, m, usage));
+
+        if (doc.is_torrent)
+        {
+            auto info_span = [&]() { (void)TorrentMeta::parse(doc.data).info.raw; };
+            usage = measure_heap(info_span);
+            m = run_timed(info_span, doc.data.size(), opt.min_time);
+            results.push_back(make_record("info_span", doc.name, doc.data.size(), m, usage));
+        }
+
+        json value = decode();
+        size_t encoded_size = bencode_encoded_size(value);
+        usage = measure_heap([&]() { (void)bencode_encode(value); });
+        m = run_timed([&]() { (void)bencode_encode(value); }, encoded_size, opt.min_time);
+        results.push_back(make_record("encode", doc.name, encoded_size, m, usage));
+    }
+
+    json report;
+    report["benchmark"] = "bencode";
+    report["min_time"] = opt.min_time;
+    json docs = json::array();
+    for (const Document& doc : corpus)
+    {
+        json d;
+        d["name"] = doc.name;
+        d["size"] = doc.data.size();
+        docs.push_back(d);
+    }
+    report["corpus"] = docs;
+    report["results"] = results;
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        report["max_rss_kb"] = usage.ru_maxrss;
+    }
+
+    if (opt.output_path.empty())
+    {
+        std::cout << report.dump(2) << std::endl;
+    }
+    else
+    {
+        std::ofstream out(opt.output_path);
+        if (!out)
+        {
+            std::cerr << "Failed to open output file: " << opt.output_path << std::endl;
+            return 1;
+        }
+        out << report.dump(2) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,277 @@
+/**
+ * @file sha1_bench.cpp
+ * @brief SHA-1 后端吞吐量基准测试
+ *
+ * 覆盖 16 KiB（block）到 16 MiB（大 piece）的缓冲区，对本机可用的每个后端测量：
+ *   - update  : 单个 SHA1 对象 update() + final()
+ *   - hash    : SHA1::hash()（经由全局选择的后端）
+ *   - batch   : sha1_hash_batch() 多缓冲区 SIMD（4/8/16 lanes）
+ *   - threads : 多线程各自用 SHA1 哈希独立缓冲区
+ *
+ * 结果以 JSON 输出到 stdout（或 -o 指定的文件），每条记录包含 MB/s 与
+ * cycles/byte（按 TSC 计，即标称频率下的周期数），便于跨版本对比回归。
+ *
+ * 用法:
+ *   sha1_bench [--min-time <seconds>] [--max-size <bytes>] [--max-threads <n>] [-o <output.json>]
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SHA1_BENCH_HAVE_TSC 1
+#else
+#define SHA1_BENCH_HAVE_TSC 0
+#endif
+
+#include "lib/nlohmann/json.hpp"
+#include "sha1.hpp"
+
+using json = nlohmann::json;
+
+namespace
+{
+
+struct BenchOptions
+{
+    double min_time = 0.25;                 // 每项至少运行的秒数
+    size_t max_size = 16 * 1024 * 1024;     // 最大缓冲区
+    unsigned max_threads = 0;               // 0 = hardware_concurrency
+    std::string output_path;                // 空 = stdout
+};
+
+struct Measurement
+{
+    uint64_t iterations = 0;
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+    uint64_t cycles = 0;
+};
+
+uint64_t read_tsc()
+{
+#if SHA1_BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief 反复执行 fn（每次处理 bytes_per_call 字节），直到累计时间不少于 min_time
+ */
+Measurement run_timed(const std::function<void()>& fn, uint64_t bytes_per_call, double min_time)
+{
+    fn(); // 预热：触发后端选择、页面分配与缓存
+
+    Measurement m;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t tsc_start = read_tsc();
+    while (true)
+    {
+        fn();
+        m.iterations++;
+        m.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (m.seconds >= min_time) break;
+    }
+    m.cycles = read_tsc() - tsc_start;
+    m.bytes = m.iterations * bytes_per_call;
+    return m;
+}
+
+json make_record(const std::string& mode, const std::string& backend, int lanes, unsigned threads, size_t size,
+                 const Measurement& m)
+{
+    json r;
+    r["mode"] = mode;
+    r["backend"] = backend;
+    r["lanes"] = lanes;
+    r["threads"] = threads;
+    r["size"] = size;
+    r["iterations"] = m.iterations;
+    r["bytes"] = m.bytes;
+    r["seconds"] = m.seconds;
+    r["mb_per_s"] = m.seconds > 0 ? static_cast<double>(m.bytes) / 1e6 / m.seconds : 0.0;
+    if (SHA1_BENCH_HAVE_TSC && m.bytes > 0)
+    {
+        r["cycles_per_byte"] = static_cast<double>(m.cycles) / static_cast<double>(m.bytes);
+    }
+    else
+    {
+        r["cycles_per_byte"] = nullptr;
+    }
+    return r;
+}
+
+BenchOptions parse_options(int argc, char* argv[])
+{
+    BenchOptions opt;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+        if (arg == "--min-time") opt.min_time = std::stod(argv[++i]);
+        else if (arg == "--max-size") opt.max_size = static_cast<size_t>(std::stoull(argv[++i]));
+        else if (arg == "--max-threads") opt.max_threads = static_cast<unsigned>(std::stoul(argv[++i]));
+        else if (arg == "-o") opt.output_path = argv[++i];
+        else throw std::runtime_error("Unknown option: " + arg);
+    }
+    return opt;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    BenchOptions opt;
+    try
+    {
+        opt = parse_options(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << "Usage: " << argv[0]
+                  << " [--min-time <seconds>] [--max-size <bytes>] [--max-threads <n>] [-o <output.json>]" << std::endl;
+        return 1;
+    }
+
+    std::vector<size_t> sizes;
+    for (size_t size = 16 * 1024; size <= opt.max_size; size *= 4) sizes.push_back(size);
+
+    const std::vector<SHA1Backend> all_backends = {SHA1Backend::Portable, SHA1Backend::ShaNi, SHA1Backend::OpenSSL};
+    std::vector<SHA1Backend> backends;
+    for (SHA1Backend b : all_backends)
+    {
+        if (SHA1::backend_available(b)) backends.push_back(b);
+    }
+
+    const int max_lanes = sha1_detail::max_batch_lanes();
+    unsigned max_threads = opt.max_threads != 0 ? opt.max_threads : std::max(1u, std::thread::hardware_concurrency());
+
+    // 一块足够所有 lane / 线程各用独立区间的随机数据，避免不同输入命中同一缓存行
+    size_t max_size = sizes.empty() ? 0 : sizes.back();
+    size_t regions = std::max<size_t>(static_cast<size_t>(std::max(1, max_lanes)), max_threads);
+    std::vector<uint8_t> data(max_size * regions);
+    std::mt19937_64 rng(42);
+    for (size_t i = 0; i + 8 <= data.size(); i += 8)
+    {
+        uint64_t v = rng();
+        std::memcpy(&data[i], &v, 8);
+    }
+
+    json results = json::array();
+
+    for (size_t size : sizes)
+    {
+        // 单缓冲区：每个后端分别测 update 与 hash
+        for (SHA1Backend b : backends)
+        {
+            SHA1 sha1(b);
+            uint8_t digest[20];
+            Measurement m = run_timed([&]() {
+                sha1.update(data.data(), size);
+                sha1.final(digest);
+            }, size, opt.min_time);
+            results.push_back(make_record("update", SHA1::backend_name(b), 1, 1, size, m));
+
+            SHA1::set_backend(b);
+            std::string buf(reinterpret_cast<const char*>(data.data()), size);
+            m = run_timed([&]() { (void)SHA1::hash(buf); }, size, opt.min_time);
+            results.push_back(make_record("hash", SHA1::backend_name(b), 1, 1, size, m));
+        }
+        SHA1::set_backend(SHA1Backend::Auto);
+
+        // 多缓冲区 SIMD：lanes 个互不重叠的缓冲区一起哈希
+        for (int lanes : {4, 8, 16})
+        {
+            if (lanes > max_lanes) continue;
+            sha1_set_batch_lanes(lanes);
+
+            std::vector<const uint8_t*> inputs;
+            for (int i = 0; i < lanes; i++) inputs.push_back(data.data() + static_cast<size_t>(i) * max_size);
+            std::vector<uint8_t> digests(static_cast<size_t>(lanes) * 20);
+            Measurement m = run_timed([&]() {
+                sha1_hash_batch(inputs.data(), inputs.size(), size, reinterpret_cast<uint8_t(*)[20]>(digests.data()));
+            }, static_cast<uint64_t>(size) * lanes, opt.min_time);
+            results.push_back(make_record("batch", "simd", lanes, 1, size, m));
+        }
+        sha1_set_batch_lanes(0);
+
+        // 多线程：每个线程用自动选择的后端哈希自己的缓冲区，固定轮数后汇总
+        SHA1Backend active = SHA1::active_backend();
+        for (unsigned threads = 1; threads <= max_threads; threads *= 2)
+        {
+            // 先测单线程一轮的耗时，估算达到 min_time 需要的轮数
+            Measurement probe = run_timed([&]() {
+                SHA1 sha1(active);
+                sha1.update(data.data(), size);
+                (void)sha1.final();
+            }, size, opt.min_time / 4);
+            uint64_t rounds = std::max<uint64_t>(1, probe.iterations * 4 / threads);
+
+            Measurement m;
+            auto start = std::chrono::steady_clock::now();
+            uint64_t tsc_start = read_tsc();
+            std::vector<std::thread> pool;
+            for (unsigned t = 0; t < threads; t++)
+            {
+                pool.emplace_back([&, t]() {
+                    SHA1 sha1(active);
+                    const uint8_t* base = data.data() + static_cast<size_t>(t) * max_size;
+                    for (uint64_t r = 0; r < rounds; r++)
+                    {
+                        sha1.update(base, size);
+                        (void)sha1.final();
+                    }
+                });
+            }
+            for (auto& th : pool) th.join();
+            m.cycles = read_tsc() - tsc_start;
+            m.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            m.iterations = rounds * threads;
+            m.bytes = m.iterations * size;
+            // cycles/byte 按墙钟 TSC 计，多线程时反映的是整机吞吐
+            results.push_back(make_record("threads", SHA1::backend_name(active), 1, threads, size, m));
+        }
+    }
+
+    json report;
+    report["benchmark"] = "sha1";
+    json cpu;
+    cpu["hardware_concurrency"] = std::thread::hardware_concurrency();
+    cpu["sha_ni"] = SHA1::backend_available(SHA1Backend::ShaNi);
+    cpu["max_batch_lanes"] = max_lanes;
+    report["cpu"] = cpu;
+    report["auto_backend"] = SHA1::backend_name(SHA1::active_backend());
+    report["auto_batch_lanes"] = sha1_batch_lanes();
+    report["min_time"] = opt.min_time;
+    report["results"] = results;
+
+    if (opt.output_path.empty())
+    {
+        std::cout << report.dump(2) << std::endl;
+    }
+    else
+    {
+        std::ofstream out(opt.output_path);
+        if (!out)
+        {
+            std::cerr << "Failed to open output file: " << opt.output_path << std::endl;
+            return 1;
+        }
+        out << report.dump(2) << std::endl;
+    }
+    return 0;
+}
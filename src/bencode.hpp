@@ -0,0 +1,1824 @@
+/**
+ * @file bencode.hpp
+ * @brief Bencode 编解码
+ *
+ * - decode_bencoded_value : 解码为 nlohmann::json（需要修改或重新编码的场景）
+ * - bencode_encode        : 由 nlohmann::json 编码（先算精确长度，再一次写入；bencode_append 追加到已有缓冲区）
+ * - BencodeView           : 零拷贝只读视图，直接在输入缓冲区上导航，字符串以 string_view 返回
+ * - BencodeDocument       : 一遍扫描建立结构索引（tape + skip link），按键查找只在索引上跳转
+ * - BencodeValue          : arena 分配的通用值树（列表/字典为连续数组），整棵树一次释放
+ * - BencodeStreamParser   : 事件驱动（SAX）解析器，输入可分块到达，内存只与嵌套深度有关
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <charconv>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BENCODE_HAVE_X86 1
+#else
+#define BENCODE_HAVE_X86 0
+#endif
+
+#include "lib/nlohmann/json.hpp"
+
+using json = nlohmann::json;
+
+// ============================================================================
+// 词法扫描
+// ============================================================================
+//
+// 分隔符（'e'）查找与数字串扫描在 x86 上用 SSE2（x86-64 基线）/ AVX2 一次比较 16/32 字节，
+// 其余平台与尾部用标量循环。长度与整数都用 from_chars 解析并检查溢出；
+// 字符串长度在分配任何内存之前先与剩余输入比较。
+
+namespace bencode_detail
+{
+
+#if BENCODE_HAVE_X86
+inline bool cpu_has_avx2()
+{
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+}
+
+/**
+ * @brief 按 32 字节块查找 c；找到返回其位置，否则返回 nullptr，p 前进到未扫描的尾部
+ */
+__attribute__((target("avx2")))
+inline const char* find_byte_avx2(const char*& p, const char* end, char c)
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+    for (; end - p >= 32; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    return nullptr;
+}
+
+inline const char* find_byte_sse2(const char*& p, const char* end, char c)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle)));
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    return nullptr;
+}
+#endif
+
+/**
+ * @brief [p, end) 中第一个 c 的位置，没有时返回 end
+ */
+inline const char* find_byte(const char* p, const char* end, char c)
+{
+#if BENCODE_HAVE_X86
+    if (end - p >= 32 && cpu_has_avx2())
+    {
+        if (const char* hit = find_byte_avx2(p, end, c)) return hit;
+    }
+    if (const char* hit = find_byte_sse2(p, end, c)) return hit;
+#endif
+    while (p < end && *p != c) p++;
+    return p;
+}
+
+/**
+ * @brief 跳过从 p 开始的连续十进制数字，返回第一个非数字的位置
+ */
+inline const char* skip_digits(const char* p, const char* end)
+{
+#if BENCODE_HAVE_X86
+    // 有符号比较：>= 0x80 的字节是负数，自然落在 '0' 之下
+    const __m128i lo = _mm_set1_epi8('0');
+    const __m128i hi = _mm_set1_epi8('9');
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i outside = _mm_or_si128(_mm_cmplt_epi8(v, lo), _mm_cmpgt_epi8(v, hi));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(outside));
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+#endif
+    while (p < end && *p >= '0' && *p <= '9') p++;
+    return p;
+}
+
+/**
+ * @brief 解析 pos 处字符串的长度前缀，返回内容起始位置，len 为内容长度
+ *
+ * @throws std::runtime_error 缺少数字或 ':'、长度溢出、或超出剩余输入
+ */
+inline size_t parse_string_header(std::string_view input, size_t pos, size_t& len)
+{
+    const char* end = input.data() + input.size();
+    const char* first = input.data() + pos;
+    const char* last = skip_digits(first, end);
+    if (last == first || last == end || *last != ':')
+    {
+        throw std::runtime_error("Invalid bencode string");
+    }
+
+    uint64_t value = 0;
+    auto [ptr, ec] = std::from_chars(first, last, value);
+    if (ec != std::errc() || ptr != last) throw std::runtime_error("Bencode string length out of range");
+
+    size_t start = static_cast<size_t>(last - input.data()) + 1; // 跳过 ':'
+    if (value > input.size() - start) throw std::runtime_error("Bencode string exceeds input");
+    len = static_cast<size_t>(value);
+    return start;
+}
+
+/**
+ * @brief 解析 pos 处的整数 "i<数字>e"，返回其后的位置
+ *
+ * @throws std::runtime_error 缺少 'e'、含非数字字符、有前导零或为 "-0"、或超出 int64 范围
+ */
+inline size_t parse_integer(std::string_view input, size_t pos, int64_t& value)
+{
+    if (pos >= input.size() || input[pos] != 'i') throw std::runtime_error("Invalid bencode integer");
+
+    const char* end = input.data() + input.size();
+    const char* first = input.data() + pos + 1;
+    const char* last = find_byte(first, end, 'e');
+    if (last == end) throw std::runtime_error("Unterminated bencode integer");
+
+    // 规范形式唯一：不允许 "i03e" 这样的前导零，也不允许 "i-0e"
+    const char* digits = first != last && *first == '-' ? first + 1 : first;
+    if (digits != last && *digits == '0' && (last - digits > 1 || digits != first))
+    {
+        throw std::runtime_error("Invalid bencode integer");
+    }
+
+    auto [ptr, ec] = std::from_chars(first, last, value);
+    if (ec == std::errc::result_out_of_range) throw std::runtime_error("Bencode integer out of range");
+    if (ec != std::errc() || ptr != last) throw std::runtime_error("Invalid bencode integer");
+    return static_cast<size_t>(last - input.data()) + 1;
+}
+
+/**
+ * @brief skip_value 的默认嵌套上限，也是它能记录的最大深度
+ */
+inline constexpr size_t max_nesting_depth = 512;
+
+/**
+ * @brief 跳过 pos 处的一个完整值（同时做格式与越界检查），返回其后的位置
+ *
+ * 迭代实现：每层只需要记住容器是列表还是字典，放在一个位栈里，不占用调用栈；
+ * 因此 BencodeView 面对深层嵌套的输入只会抛出异常。
+ *
+ * @param max_depth 最大嵌套层数（不超过 max_nesting_depth），超出时抛出异常
+ */
+inline size_t skip_value(std::string_view input, size_t pos, size_t max_depth = max_nesting_depth)
+{
+    max_depth = std::min(max_depth, max_nesting_depth);
+    uint64_t dict_bits[max_nesting_depth / 64]; // 第 n 位：第 n 层是字典
+    size_t depth = 0;
+
+    while (true)
+    {
+        if (pos >= input.size())
+        {
+            throw std::runtime_error(depth == 0 ? "Unexpected end of bencode input" : "Unterminated bencode container");
+        }
+
+        char c = input[pos];
+        if (depth > 0)
+        {
+            if (c == 'e')
+            {
+                pos++;
+                if (--depth == 0) return pos;
+                continue;
+            }
+
+            bool in_dict = ((dict_bits[(depth - 1) / 64] >> ((depth - 1) % 64)) & 1) != 0;
+            if (in_dict)
+            {
+                // 先读键，后面紧跟的就是它的值
+                if (!(c >= '0' && c <= '9')) throw std::runtime_error("Bencode dictionary key must be a string");
+                size_t len = 0;
+                pos = parse_string_header(input, pos, len) + len;
+                if (pos >= input.size()) throw std::runtime_error("Unterminated bencode container");
+                c = input[pos];
+                if (c == 'e') throw std::runtime_error("Bencode dictionary key without value");
+            }
+        }
+
+        if (c >= '0' && c <= '9')
+        {
+            size_t len = 0;
+            pos = parse_string_header(input, pos, len) + len;
+        }
+        else if (c == 'i')
+        {
+            int64_t value = 0;
+            pos = parse_integer(input, pos, value);
+        }
+        else if (c == 'l' || c == 'd')
+        {
+            if (depth >= max_depth) throw std::runtime_error("Bencode nesting too deep");
+            uint64_t bit = uint64_t(1) << (depth % 64);
+            if (c == 'd') dict_bits[depth / 64] |= bit;
+            else dict_bits[depth / 64] &= ~bit;
+            depth++;
+            pos++;
+            continue;
+        }
+        else
+        {
+            throw std::runtime_error("Invalid bencode value");
+        }
+
+        if (depth == 0) return pos;
+    }
+}
+
+} // namespace bencode_detail
+
+// ============================================================================
+// Bencode 解码函数（nlohmann::json）
+// ============================================================================
+
+namespace bencode_detail
+{
+
+/**
+ * @brief decode_bencoded_value 的显式栈帧：一个尚未闭合的列表或字典
+ */
+struct JsonFrame
+{
+    json container;       // 正在构建的 json::array 或 json::object
+    std::string key;      // 字典中已读出、等待值的键
+    bool has_key = false;
+};
+
+} // namespace bencode_detail
+
+/**
+ * @brief 解码 Bencode 编码的值（带位置跟踪）
+ * 
+ * Bencode 支持四种数据类型：
+ * 1. 字符串 (Strings): 格式为 "<长度>:<内容>"，例如 "5:hello" 表示字符串 "hello"
+ * 2. 整数 (Integers): 格式为 "i<数字>e"，例如 "i52e" 表示整数 52，"i-52e" 表示 -52
+ * 3. 列表 (Lists): 格式为 "l<元素>e"，例如 "l5:helloi52ee" 表示 ["hello", 52]
+ * 4. 字典 (Dictionaries): 格式为 "d<键值对>e"，例如 "d3:foo3:bare" 表示 {"foo":"bar"}
+ * 
+ * 解析是迭代的：未闭合的列表/字典放在显式栈上，而不是占用 C++ 调用栈，
+ * 因此来自对端的深层嵌套数据（ut_metadata、tracker 响应）最多只会触发 max_depth 异常；
+ * 每次读取字符前都检查是否已到输入末尾。
+ * 
+ * @param encoded_value Bencode 编码的字符串
+ * @param pos 当前解析位置（引用，会被更新为解析结束后的位置）
+ * @param max_depth 最大嵌套层数，超出时抛出异常
+ * @return json 解码后的 JSON 对象
+ * @throws std::runtime_error 当遇到无效或不支持的编码格式、输入截断或嵌套过深时抛出异常
+ */
+inline json decode_bencoded_value(const std::string& encoded_value, size_t& pos,
+                                  size_t max_depth = bencode_detail::max_nesting_depth)
+{
+    std::vector<bencode_detail::JsonFrame> frames;
+    
+    while (true)
+    {
+        if (pos >= encoded_value.size()) throw std::runtime_error("Unexpected end of bencode input");
+        char c = encoded_value[pos];
+        json value;
+        
+        if (c >= '0' && c <= '9') 
+        {
+            // ================================================================
+            // 解码 Bencode 字符串
+            // ================================================================
+            // 格式: "<长度>:<字符串内容>"
+            // 
+            // 解析示例: "5:hello"
+            //   - "5" 是长度（表示后面有 5 个字符）
+            //   - ":" 是分隔符
+            //   - "hello" 是实际内容
+            // 
+            // 解析步骤:
+            //   1. 向量化扫描连续数字，下一个字符必须是 ':'
+            //   2. from_chars 解析长度，溢出或超出剩余输入时在分配前就报错
+            //   3. 从冒号后提取 length 个字符
+            //   4. 更新 pos 到字符串末尾之后
+            
+            size_t length = 0;
+            size_t start = bencode_detail::parse_string_header(encoded_value, pos, length);
+            
+            // 更新位置：指向 "5:hello" 之后
+            pos = start + length;
+            
+            // 字典中等待键时，这个字符串就是键，读完继续解析它的值
+            if (!frames.empty() && frames.back().container.is_object() && !frames.back().has_key)
+            {
+                frames.back().key.assign(encoded_value, start, length);
+                frames.back().has_key = true;
+                continue;
+            }
+            value = encoded_value.substr(start, length);
+        } 
+        else if (c == 'i')
+        {
+            // ================================================================
+            // 解码 Bencode 整数
+            // ================================================================
+            // 格式: "i<数字>e"
+            // 
+            // 解析示例: "i52e"
+            //   - "i" 是起始标记
+            //   - "52" 是数字内容
+            //   - "e" 是结束标记
+            // 
+            // 解析步骤:
+            //   1. 向量化查找结束标记 'e'
+            //   2. from_chars 直接在 'i' 与 'e' 之间解析，不构造子串；
+            //      非数字字符或超出 int64 范围都会报错（而不是被 atoll 静默截断）
+            //   3. 更新 pos 到 'e' 之后
+            
+            int64_t number = 0;
+            pos = bencode_detail::parse_integer(encoded_value, pos, number);
+            value = number;
+        }
+        else if (c == 'l' || c == 'd')
+        {
+            // ================================================================
+            // 列表 / 字典开始
+            // ================================================================
+            // 格式: "l<元素1><元素2>...e" 与 "d<key1><value1><key2><value2>...e"
+            // 
+            // 不递归：压入一个新的栈帧，之后解析出的值都挂到栈顶容器上，
+            // 直到遇到对应的 'e' 才弹出。
+            // 
+            // 解析 "d3:foo3:bar5:helloi52ee" -> {"foo":"bar","hello":52}:
+            //   | pos | 当前字符 | 操作                      | 栈顶                          |
+            //   |-----|---------|--------------------------|-------------------------------|
+            //   | 0   | 'd'     | 压入字典帧                 | {}                            |
+            //   | 1   | '3'     | 等待键 -> key="foo"        | {}, key="foo"                 |
+            //   | 6   | '3'     | 值 "bar" 挂到字典上         | {"foo":"bar"}                 |
+            //   | 11  | '5'     | 等待键 -> key="hello"      | {"foo":"bar"}, key="hello"    |
+            //   | 18  | 'i'     | 值 52 挂到字典上            | {"foo":"bar","hello":52}      |
+            //   | 22  | 'e'     | 弹出，字典本身成为一个值      | （空）                         |
+            
+            if (!frames.empty() && frames.back().container.is_object() && !frames.back().has_key)
+            {
+                throw std::runtime_error("Bencode dictionary key must be a string");
+            }
+            if (frames.size() >= max_depth) throw std::runtime_error("Bencode nesting too deep");
+            
+            frames.emplace_back();
+            frames.back().container = c == 'l' ? json::array() : json::object();
+            pos++;
+            continue;
+        }
+        else if (c == 'e' && !frames.empty())
+        {
+            // ================================================================
+            // 列表 / 字典结束：栈顶容器闭合，作为一个完整的值交给上一层
+            // ================================================================
+            if (frames.back().has_key) throw std::runtime_error("Bencode dictionary key without value");
+            
+            value = std::move(frames.back().container);
+            frames.pop_back();
+            pos++;
+        }
+        else 
+        {
+            // 遇到未知的编码类型：只报告位置与该字节，不把（可能很大的）输入放进异常信息
+            const char digits[] = "0123456789abcdef";
+            unsigned char byte = static_cast<unsigned char>(c);
+            throw std::runtime_error("Unhandled encoded value at offset " + std::to_string(pos) + ": byte 0x" +
+                                     digits[byte >> 4] + digits[byte & 0x0F]);
+        }
+        
+        // 一个完整的值：没有未闭合的容器时就是结果，否则挂到栈顶容器上
+        if (frames.empty()) return value;
+        
+        bencode_detail::JsonFrame& parent = frames.back();
+        if (parent.container.is_array())
+        {
+            parent.container.get_ref<json::array_t&>().push_back(std::move(value));
+        }
+        else
+        {
+            if (!parent.has_key) throw std::runtime_error("Bencode dictionary key must be a string");
+            // 重复的键以后出现的为准
+            parent.container.get_ref<json::object_t&>().insert_or_assign(std::move(parent.key), std::move(value));
+            parent.key.clear();
+            parent.has_key = false;
+        }
+    }
+}
+
+/**
+ * @brief 解码 Bencode 编码的值（便捷包装函数）
+ * 
+ * 这是一个便捷的包装函数，内部创建位置变量并调用带位置跟踪的解码函数。
+ * 
+ * @param encoded_value Bencode 编码的字符串
+ * @return json 解码后的 JSON 对象
+ */
+inline json decode_bencoded_value(const std::string& encoded_value)
+{
+    size_t pos = 0;
+    return decode_bencoded_value(encoded_value, pos);
+}
+
+// ============================================================================
+// Bencode 编码函数
+// ============================================================================
+
+// 编码分两步：先由 bencode_encoded_size() 精确算出输出长度，再把整个值直接写进
+// 一次性分配好的缓冲区，中间不产生任何临时字符串。json 对象底层是 std::map，
+// 遍历顺序本身就是按键的字节序，正好满足 bencode 字典键有序的要求，无需再排序。
+
+namespace bencode_detail
+{
+
+/**
+ * @brief 十进制位数（含负号）
+ */
+inline size_t decimal_length(int64_t value)
+{
+    size_t n = value < 0 ? 2 : 1;
+    uint64_t v = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    while (v >= 10)
+    {
+        v /= 10;
+        n++;
+    }
+    return n;
+}
+
+inline char* write_decimal(char* out, int64_t value)
+{
+    return std::to_chars(out, out + 20, value).ptr;
+}
+
+inline char* write_string(char* out, std::string_view s)
+{
+    out = write_decimal(out, static_cast<int64_t>(s.size()));
+    *out++ = ':';
+    std::memcpy(out, s.data(), s.size());
+    return out + s.size();
+}
+
+/**
+ * @brief 把 j 的编码写到 out，返回写入末尾；out 必须至少有 bencode_encoded_size(j) 字节
+ */
+inline char* write_value(char* out, const json& j)
+{
+    if (j.is_string())
+    {
+        return write_string(out, j.get_ref<const std::string&>());
+    }
+    if (j.is_number_integer())
+    {
+        *out++ = 'i';
+        out = write_decimal(out, j.get<int64_t>());
+        *out++ = 'e';
+        return out;
+    }
+    if (j.is_array())
+    {
+        *out++ = 'l';
+        for (const auto& item : j) out = write_value(out, item);
+        *out++ = 'e';
+        return out;
+    }
+    if (j.is_object())
+    {
+        *out++ = 'd';
+        for (auto it = j.begin(); it != j.end(); ++it)
+        {
+            out = write_string(out, it.key());
+            out = write_value(out, it.value());
+        }
+        *out++ = 'e';
+        return out;
+    }
+    throw std::runtime_error("Unsupported JSON type for bencode encoding");
+}
+
+} // namespace bencode_detail
+
+/**
+ * @brief j 编码后的精确字节数
+ */
+inline size_t bencode_encoded_size(const json& j)
+{
+    using bencode_detail::decimal_length;
+    if (j.is_string())
+    {
+        size_t len = j.get_ref<const std::string&>().size();
+        return decimal_length(static_cast<int64_t>(len)) + 1 + len;
+    }
+    if (j.is_number_integer())
+    {
+        return decimal_length(j.get<int64_t>()) + 2;
+    }
+    if (j.is_array())
+    {
+        size_t size = 2;
+        for (const auto& item : j) size += bencode_encoded_size(item);
+        return size;
+    }
+    if (j.is_object())
+    {
+        size_t size = 2;
+        for (auto it = j.begin(); it != j.end(); ++it)
+        {
+            size += decimal_length(static_cast<int64_t>(it.key().size())) + 1 + it.key().size();
+            size += bencode_encoded_size(it.value());
+        }
+        return size;
+    }
+    throw std::runtime_error("Unsupported JSON type for bencode encoding");
+}
+
+/**
+ * @brief 把 j 的编码追加到 out 末尾（只扩容一次）
+ *
+ * 用于直接在消息缓冲区里拼装 "长度前缀 + id + payload"，不产生中间字符串。
+ */
+inline void bencode_append(std::string& out, const json& j)
+{
+    size_t size = bencode_encoded_size(j);
+    size_t pos = out.size();
+    out.resize(pos + size);
+    char* end = bencode_detail::write_value(&out[pos], j);
+    if (end != out.data() + pos + size) throw std::runtime_error("Bencode size mismatch");
+}
+
+/**
+ * @brief 将 JSON 对象编码为 Bencode 格式
+ */
+
+//  {"m": {"ut_metadata": 1}}
+//         ↓ bencode_encode
+// d                           ← 字典开始
+//   1:m                       ← 键 "m" (长度1)
+//   d                         ← 值是字典，字典开始
+//     11:ut_metadata          ← 键 "ut_metadata" (长度11)
+//     i1e                     ← 值 1 (整数)
+//   e                         ← 内层字典结束
+// e                           ← 外层字典结束
+
+// 最终: "d1:md11:ut_metadatai1eee"
+inline std::string bencode_encode(const json& j)
+{
+    std::string result;
+    bencode_append(result, j);
+    return result;
+}
+
+// ============================================================================
+// 零拷贝 Bencode 视图
+// ============================================================================
+//
+// BencodeView 只记录一个值在原始缓冲区中的字节区间（std::string_view），
+// 字符串通过 as_string() 直接返回指向原缓冲区的视图，整数在读取时就地解析，
+// 列表/字典的子元素在访问时顺序扫描得到。整个过程不分配内存、不拷贝负载，
+// 20 MB 的 pieces 字段只是一个 (指针, 长度)。
+//
+// 视图不拥有数据：原始缓冲区必须比所有由它得到的视图活得更久。
+
+class BencodeView
+{
+public:
+    enum class Type
+    {
+        String,
+        Integer,
+        List,
+        Dict,
+    };
+
+    /**
+     * @brief 字典的键值对；遍历列表时 key 为空
+     */
+    struct Entry
+    {
+        std::string_view key;
+        BencodeView value() const { return BencodeView(value_raw); }
+        std::string_view value_raw;
+    };
+
+    /**
+     * @brief 顺序遍历列表元素 / 字典键值对
+     */
+    class iterator
+    {
+    public:
+        iterator(std::string_view container, size_t pos) : container_(container), pos_(pos) { load(); }
+
+        const Entry& operator*() const { return entry_; }
+        const Entry* operator->() const { return &entry_; }
+
+        iterator& operator++()
+        {
+            pos_ = next_;
+            load();
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const { return pos_ == other.pos_; }
+        bool operator!=(const iterator& other) const { return pos_ != other.pos_; }
+
+    private:
+        void load()
+        {
+            if (pos_ >= container_.size() - 1) return; // 指向结尾的 'e'
+            size_t value_pos = pos_;
+            entry_.key = {};
+            if (container_[0] == 'd')
+            {
+                size_t len = 0;
+                size_t start = bencode_detail::parse_string_header(container_, pos_, len);
+                entry_.key = container_.substr(start, len);
+                value_pos = start + len;
+            }
+            next_ = bencode_detail::skip_value(container_, value_pos);
+            entry_.value_raw = container_.substr(value_pos, next_ - value_pos);
+        }
+
+        std::string_view container_;
+        size_t pos_ = 0;
+        size_t next_ = 0;
+        Entry entry_;
+    };
+
+    BencodeView() = default;
+
+    /**
+     * @brief 解析 input 中从 pos 开始的一个值，pos 更新为该值之后的位置（允许后面还有数据）
+     * @throws std::runtime_error 格式错误、输入截断或嵌套超过 bencode_detail::max_nesting_depth 层
+     */
+    static BencodeView parse(std::string_view input, size_t& pos)
+    {
+        size_t end = bencode_detail::skip_value(input, pos);
+        BencodeView view(input.substr(pos, end - pos));
+        pos = end;
+        return view;
+    }
+
+    /**
+     * @brief 解析整个 input，它必须恰好是一个完整的值
+     */
+    static BencodeView parse(std::string_view input)
+    {
+        size_t pos = 0;
+        BencodeView view = parse(input, pos);
+        if (pos != input.size()) throw std::runtime_error("Trailing data after bencode value");
+        return view;
+    }
+
+    Type type() const
+    {
+        if (raw_.empty()) throw std::runtime_error("Empty bencode view");
+        switch (raw_[0])
+        {
+            case 'i': return Type::Integer;
+            case 'l': return Type::List;
+            case 'd': return Type::Dict;
+            default: return Type::String;
+        }
+    }
+
+    bool is_string() const { return !raw_.empty() && raw_[0] >= '0' && raw_[0] <= '9'; }
+    bool is_int() const { return !raw_.empty() && raw_[0] == 'i'; }
+    bool is_list() const { return !raw_.empty() && raw_[0] == 'l'; }
+    bool is_dict() const { return !raw_.empty() && raw_[0] == 'd'; }
+
+    /**
+     * @brief 该值完整的原始编码（如 info 字典的原始字节，可直接用于计算 info hash）
+     */
+    std::string_view raw() const { return raw_; }
+
+    /**
+     * @brief 字符串内容，指向原始缓冲区
+     */
+    std::string_view as_string() const
+    {
+        if (!is_string()) throw std::runtime_error("Bencode value is not a string");
+        size_t len = 0;
+        size_t start = bencode_detail::parse_string_header(raw_, 0, len);
+        return raw_.substr(start, len);
+    }
+
+    int64_t as_int() const
+    {
+        if (!is_int()) throw std::runtime_error("Bencode value is not an integer");
+        int64_t value = 0;
+        const char* first = raw_.data() + 1;
+        const char* last = raw_.data() + raw_.size() - 1;
+        auto [ptr, ec] = std::from_chars(first, last, value);
+        if (ec != std::errc() || ptr != last) throw std::runtime_error("Invalid bencode integer");
+        return value;
+    }
+
+    iterator begin() const
+    {
+        if (!is_list() && !is_dict()) throw std::runtime_error("Bencode value is not a container");
+        return iterator(raw_, 1);
+    }
+
+    iterator end() const
+    {
+        return iterator(raw_, raw_.size() - 1);
+    }
+
+    /**
+     * @brief 列表元素个数 / 字典键值对个数
+     */
+    size_t size() const
+    {
+        size_t n = 0;
+        for (auto it = begin(); it != end(); ++it) n++;
+        return n;
+    }
+
+    /**
+     * @brief 字典中查找键；不存在时返回空视图（raw() 为空）
+     */
+    BencodeView find(std::string_view key) const
+    {
+        if (!is_dict()) throw std::runtime_error("Bencode value is not a dictionary");
+        for (const Entry& entry : *this)
+        {
+            if (entry.key == key) return entry.value();
+        }
+        return BencodeView();
+    }
+
+    bool contains(std::string_view key) const
+    {
+        return is_dict() && !find(key).raw_.empty();
+    }
+
+    /**
+     * @brief 字典取值，键不存在时抛出异常
+     */
+    BencodeView operator[](std::string_view key) const
+    {
+        BencodeView value = find(key);
+        if (value.raw_.empty()) throw std::runtime_error("Missing bencode key: " + std::string(key));
+        return value;
+    }
+
+    /**
+     * @brief 列表取第 index 个元素
+     */
+    BencodeView at(size_t index) const
+    {
+        if (!is_list()) throw std::runtime_error("Bencode value is not a list");
+        for (const Entry& entry : *this)
+        {
+            if (index-- == 0) return entry.value();
+        }
+        throw std::runtime_error("Bencode list index out of range");
+    }
+
+private:
+    explicit BencodeView(std::string_view raw) : raw_(raw) {}
+
+    std::string_view raw_;
+};
+
+// ============================================================================
+// 结构索引（tape）
+// ============================================================================
+//
+// BencodeDocument 对输入只扫描一遍，把每个值记录为 tape 上的一个 token：
+// 起止偏移，以及跳过整个子树后的下一个 token 下标（skip link）。
+// 之后 doc["info"]["piece length"] 这样的查找只沿 tape 上的兄弟链跳转，
+// 每层只比较该字典自己的键，不再逐字节扫描值的内容，也不构建任何树。
+
+namespace bencode_detail
+{
+
+struct TapeToken
+{
+    uint32_t begin; // 值的第一个字节（'i' / 'l' / 'd' / 长度前缀）
+    uint32_t end;   // 值之后的位置
+    uint32_t next;  // 跳过该值整个子树后的下一个 token 下标
+    uint32_t extra; // 字符串：内容起始偏移；容器：元素个数（字典为键值对数）
+};
+
+} // namespace bencode_detail
+
+/**
+ * @brief BencodeDocument 中一个值的句柄（输入缓冲区 + tape 下标），可随意拷贝
+ *
+ * 接口与 BencodeView 相同；size() 为 O(1)，find()/at() 只在 tape 上跳转。
+ */
+class BencodeNode
+{
+public:
+    using Type = BencodeView::Type;
+
+    /**
+     * @brief 字典的键值对；遍历列表时 key 为空
+     */
+    struct Entry
+    {
+        std::string_view key;
+        BencodeNode value() const { return BencodeNode(input, tape, value_index); }
+        std::string_view input;
+        const bencode_detail::TapeToken* tape = nullptr;
+        uint32_t value_index = 0;
+    };
+
+    /**
+     * @brief 顺序遍历列表元素 / 字典键值对（沿 skip link 跳过子树）
+     */
+    class iterator
+    {
+    public:
+        iterator(std::string_view input, const bencode_detail::TapeToken* tape, uint32_t container, uint32_t index)
+            : dict_(input[tape[container].begin] == 'd'), end_(tape[container].next), index_(index)
+        {
+            entry_.input = input;
+            entry_.tape = tape;
+            load();
+        }
+
+        const Entry& operator*() const { return entry_; }
+        const Entry* operator->() const { return &entry_; }
+
+        iterator& operator++()
+        {
+            index_ = entry_.tape[entry_.value_index].next;
+            load();
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const iterator& other) const { return index_ != other.index_; }
+
+    private:
+        void load()
+        {
+            if (index_ >= end_) return;
+            entry_.key = {};
+            entry_.value_index = index_;
+            if (dict_)
+            {
+                const bencode_detail::TapeToken& k = entry_.tape[index_];
+                entry_.key = entry_.input.substr(k.extra, k.end - k.extra);
+                entry_.value_index = index_ + 1;
+            }
+        }
+
+        bool dict_ = false;
+        uint32_t end_ = 0;
+        uint32_t index_ = 0;
+        Entry entry_;
+    };
+
+    BencodeNode() = default;
+
+    Type type() const
+    {
+        if (tape_ == nullptr) throw std::runtime_error("Empty bencode node");
+        switch (lead())
+        {
+            case 'i': return Type::Integer;
+            case 'l': return Type::List;
+            case 'd': return Type::Dict;
+            default: return Type::String;
+        }
+    }
+
+    bool is_string() const { return tape_ != nullptr && lead() >= '0' && lead() <= '9'; }
+    bool is_int() const { return tape_ != nullptr && lead() == 'i'; }
+    bool is_list() const { return tape_ != nullptr && lead() == 'l'; }
+    bool is_dict() const { return tape_ != nullptr && lead() == 'd'; }
+
+    /**
+     * @brief 该值完整的原始编码
+     */
+    std::string_view raw() const
+    {
+        if (tape_ == nullptr) return {};
+        return input_.substr(token().begin, token().end - token().begin);
+    }
+
+    std::string_view as_string() const
+    {
+        if (!is_string()) throw std::runtime_error("Bencode value is not a string");
+        return input_.substr(token().extra, token().end - token().extra);
+    }
+
+    int64_t as_int() const
+    {
+        if (!is_int()) throw std::runtime_error("Bencode value is not an integer");
+        int64_t value = 0;
+        const char* first = input_.data() + token().begin + 1;
+        const char* last = input_.data() + token().end - 1;
+        auto [ptr, ec] = std::from_chars(first, last, value);
+        if (ec != std::errc() || ptr != last) throw std::runtime_error("Invalid bencode integer");
+        return value;
+    }
+
+    iterator begin() const
+    {
+        if (!is_list() && !is_dict()) throw std::runtime_error("Bencode value is not a container");
+        return iterator(input_, tape_, index_, index_ + 1);
+    }
+
+    iterator end() const
+    {
+        return iterator(input_, tape_, index_, token().next);
+    }
+
+    /**
+     * @brief 列表元素个数 / 字典键值对个数（建索引时已记录）
+     */
+    size_t size() const
+    {
+        if (!is_list() && !is_dict()) throw std::runtime_error("Bencode value is not a container");
+        return token().extra;
+    }
+
+    /**
+     * @brief 字典中查找键；不存在时返回空句柄（raw() 为空）
+     */
+    BencodeNode find(std::string_view key) const
+    {
+        if (!is_dict()) throw std::runtime_error("Bencode value is not a dictionary");
+        uint32_t end_index = token().next;
+        for (uint32_t i = index_ + 1; i < end_index; i = tape_[i + 1].next)
+        {
+            const bencode_detail::TapeToken& k = tape_[i];
+            if (input_.substr(k.extra, k.end - k.extra) == key) return BencodeNode(input_, tape_, i + 1);
+        }
+        return BencodeNode();
+    }
+
+    bool contains(std::string_view key) const
+    {
+        return is_dict() && find(key).tape_ != nullptr;
+    }
+
+    /**
+     * @brief 字典取值，键不存在时抛出异常
+     */
+    BencodeNode operator[](std::string_view key) const
+    {
+        BencodeNode value = find(key);
+        if (value.tape_ == nullptr) throw std::runtime_error("Missing bencode key: " + std::string(key));
+        return value;
+    }
+
+    /**
+     * @brief 列表取第 index 个元素
+     */
+    BencodeNode at(size_t index) const
+    {
+        if (!is_list()) throw std::runtime_error("Bencode value is not a list");
+        if (index >= token().extra) throw std::runtime_error("Bencode list index out of range");
+        uint32_t i = index_ + 1;
+        while (index-- > 0) i = tape_[i].next;
+        return BencodeNode(input_, tape_, i);
+    }
+
+private:
+    friend class BencodeDocument;
+
+    BencodeNode(std::string_view input, const bencode_detail::TapeToken* tape, uint32_t index)
+        : input_(input), tape_(tape), index_(index)
+    {
+    }
+
+    const bencode_detail::TapeToken& token() const { return tape_[index_]; }
+    char lead() const { return input_[token().begin]; }
+
+    std::string_view input_;
+    const bencode_detail::TapeToken* tape_ = nullptr;
+    uint32_t index_ = 0;
+};
+
+/**
+ * @brief 带结构索引的 bencode 文档
+ *
+ * 只引用输入缓冲区（调用方保证其生命周期），自身只持有 tape
+ * （每个值 16 字节）。BencodeNode 指向 tape 的存储，文档移动后依然有效，
+ * 但不能比文档活得更久。
+ */
+class BencodeDocument
+{
+public:
+    BencodeDocument() = default;
+
+    /**
+     * @brief 一遍扫描建立 tape；input 必须恰好是一个完整的值
+     *
+     * 未闭合的容器记在堆上的栈里，不递归；嵌套超过 max_depth 层时抛出异常。
+     *
+     * @throws std::runtime_error 格式错误、越界、嵌套过深或输入超过 4 GiB
+     */
+    static BencodeDocument parse(std::string_view input, size_t max_depth = bencode_detail::max_nesting_depth)
+    {
+        if (input.size() >= UINT32_MAX) throw std::runtime_error("Bencode input too large");
+
+        BencodeDocument doc;
+        doc.input_ = input;
+        std::vector<bencode_detail::TapeToken>& tape = doc.tape_;
+        std::vector<uint32_t> open; // 尚未闭合的容器的 token 下标
+
+        size_t pos = 0;
+        do
+        {
+            if (pos >= input.size()) throw std::runtime_error("Unexpected end of bencode input");
+            char c = input[pos];
+
+            if (c == 'e' && !open.empty())
+            {
+                bencode_detail::TapeToken& container = tape[open.back()];
+                if (input[container.begin] == 'd')
+                {
+                    if (container.extra % 2 != 0) throw std::runtime_error("Bencode dictionary key without value");
+                    container.extra /= 2;
+                }
+                container.end = static_cast<uint32_t>(pos + 1);
+                container.next = static_cast<uint32_t>(tape.size());
+                open.pop_back();
+                pos++;
+                continue;
+            }
+
+            if (!open.empty())
+            {
+                // 容器内先按子元素个数计数，字典闭合时再折算为键值对数
+                bencode_detail::TapeToken& parent = tape[open.back()];
+                if (input[parent.begin] == 'd' && parent.extra % 2 == 0 && !(c >= '0' && c <= '9'))
+                {
+                    throw std::runtime_error("Bencode dictionary key must be a string");
+                }
+                parent.extra++;
+            }
+
+            uint32_t index = static_cast<uint32_t>(tape.size());
+            tape.push_back({static_cast<uint32_t>(pos), 0, index + 1, 0});
+
+            if (c >= '0' && c <= '9')
+            {
+                size_t len = 0;
+                size_t start = bencode_detail::parse_string_header(input, pos, len);
+                tape[index].extra = static_cast<uint32_t>(start);
+                pos = start + len;
+            }
+            else if (c == 'i')
+            {
+                pos = bencode_detail::skip_value(input, pos);
+            }
+            else if (c == 'l' || c == 'd')
+            {
+                if (open.size() >= max_depth) throw std::runtime_error("Bencode nesting too deep");
+                open.push_back(index);
+                pos++;
+                continue;
+            }
+            else
+            {
+                throw std::runtime_error("Invalid bencode value");
+            }
+            tape[index].end = static_cast<uint32_t>(pos);
+        } while (!open.empty());
+
+        if (pos != input.size()) throw std::runtime_error("Trailing data after bencode value");
+        return doc;
+    }
+
+    BencodeNode root() const
+    {
+        if (tape_.empty()) throw std::runtime_error("Empty bencode document");
+        return BencodeNode(input_, tape_.data(), 0);
+    }
+
+    BencodeNode operator[](std::string_view key) const { return root()[key]; }
+
+    /**
+     * @brief tape 上的 token 数（即值的总个数，含字典键）
+     */
+    size_t token_count() const { return tape_.size(); }
+
+private:
+    std::string_view input_;
+    std::vector<bencode_detail::TapeToken> tape_;
+};
+
+// ============================================================================
+// Arena 分配的 Bencode 值树
+// ============================================================================
+//
+// 需要通用树时（decode 命令、扩展握手），节点、字符串和子元素数组都从
+// BencodeArena 中按顺序切出：没有逐节点的堆分配，整棵树随 reset() 或
+// arena 析构一次释放。列表和字典以连续数组存放，遍历时缓存友好。
+
+struct BencodeMember;
+
+namespace bencode_detail
+{
+
+struct ArenaFrame
+{
+    bool dict;
+    bool expect_key;
+    size_t first; // 该容器第一个子元素在暂存区中的下标
+};
+
+} // namespace bencode_detail
+
+/**
+ * @brief 单调（只增不减）内存池
+ *
+ * reset() 把已有的块合并成一块保留下来，反复解析大小相近的消息时
+ * 稳态下不再向分配器申请内存。
+ */
+class BencodeArena
+{
+public:
+    explicit BencodeArena(size_t block_size = 4096) : block_size_(block_size) {}
+
+    BencodeArena(const BencodeArena&) = delete;
+    BencodeArena& operator=(const BencodeArena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t))
+    {
+        size_t offset = (used_ + align - 1) & ~(align - 1);
+        if (offset + size > capacity_)
+        {
+            add_block(size + align);
+            offset = 0;
+        }
+        used_ = offset + size;
+        bytes_allocated_ += size;
+        return current_ + offset;
+    }
+
+    template <typename T>
+    T* allocate_array(size_t count)
+    {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    /**
+     * @brief 释放所有已分配的值（之前返回的指针全部失效）
+     */
+    void reset()
+    {
+        if (blocks_.size() > 1)
+        {
+            size_t total = 0;
+            for (const auto& b : blocks_) total += b.size;
+            blocks_.clear();
+            blocks_.push_back(Block{std::make_unique<char[]>(total), total});
+        }
+        current_ = blocks_.empty() ? nullptr : blocks_.back().data.get();
+        capacity_ = blocks_.empty() ? 0 : blocks_.back().size;
+        used_ = 0;
+        bytes_allocated_ = 0;
+    }
+
+    size_t bytes_allocated() const { return bytes_allocated_; }
+
+private:
+    friend class BencodeValue;
+
+    struct Block
+    {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    void add_block(size_t min_size)
+    {
+        // 新块至少与已有总量相当，块数按对数增长
+        size_t size = std::max(block_size_, min_size);
+        if (!blocks_.empty()) size = std::max(size, blocks_.back().size * 2);
+        blocks_.push_back(Block{std::make_unique<char[]>(size), size});
+        current_ = blocks_.back().data.get();
+        capacity_ = size;
+        used_ = 0;
+    }
+
+    size_t block_size_;
+    std::vector<Block> blocks_;
+    char* current_ = nullptr;
+    size_t capacity_ = 0;
+    size_t used_ = 0;
+    size_t bytes_allocated_ = 0;
+
+    // 解析时暂存未闭合容器的子元素；跟随 arena 复用，避免每次解析重新分配
+    std::vector<bencode_detail::ArenaFrame> scratch_frames_;
+    std::vector<BencodeMember> scratch_members_;
+};
+
+/**
+ * @brief arena 中的一个 bencode 值
+ *
+ * 字符串内容拷贝进 arena，因此树不依赖输入缓冲区；字典成员按键排序存放
+ * （重复键保留最后一个，与 json 对象的语义一致），查找用二分。
+ */
+class BencodeValue
+{
+public:
+    using Type = BencodeView::Type;
+
+    BencodeValue() : integer_(0) {}
+
+    /**
+     * @brief 解析 input 中从 pos 开始的一个值，pos 更新为该值之后的位置
+     *
+     * @param max_depth 最大嵌套层数，超出时抛出异常
+     * @return 指向 arena 中的根节点，随 arena 一起释放
+     * @throws std::runtime_error 格式错误、越界或嵌套过深
+     */
+    static const BencodeValue& parse(std::string_view input, size_t& pos, BencodeArena& arena,
+                                     size_t max_depth = bencode_detail::max_nesting_depth);
+
+    /**
+     * @brief 解析整个 input，它必须恰好是一个完整的值
+     */
+    static const BencodeValue& parse(std::string_view input, BencodeArena& arena,
+                                     size_t max_depth = bencode_detail::max_nesting_depth)
+    {
+        size_t pos = 0;
+        const BencodeValue& value = parse(input, pos, arena, max_depth);
+        if (pos != input.size()) throw std::runtime_error("Trailing data after bencode value");
+        return value;
+    }
+
+    Type type() const { return type_; }
+    bool is_string() const { return type_ == Type::String; }
+    bool is_int() const { return type_ == Type::Integer; }
+    bool is_list() const { return type_ == Type::List; }
+    bool is_dict() const { return type_ == Type::Dict; }
+
+    std::string_view as_string() const
+    {
+        if (!is_string()) throw std::runtime_error("Bencode value is not a string");
+        return std::string_view(string_, size_);
+    }
+
+    int64_t as_int() const
+    {
+        if (!is_int()) throw std::runtime_error("Bencode value is not an integer");
+        return integer_;
+    }
+
+    /**
+     * @brief 字符串长度 / 列表元素个数 / 字典成员个数
+     */
+    size_t size() const { return is_int() ? 0 : size_; }
+
+    /**
+     * @brief 列表元素（连续数组）
+     */
+    const BencodeValue* items() const
+    {
+        if (!is_list()) throw std::runtime_error("Bencode value is not a list");
+        return items_;
+    }
+
+    /**
+     * @brief 字典成员（按键排序的连续数组）
+     */
+    const BencodeMember* members() const
+    {
+        if (!is_dict()) throw std::runtime_error("Bencode value is not a dictionary");
+        return members_;
+    }
+
+    const BencodeValue& at(size_t index) const
+    {
+        if (index >= size()) throw std::runtime_error("Bencode list index out of range");
+        return items()[index];
+    }
+
+    /**
+     * @brief 字典中查找键；不存在时返回 nullptr
+     */
+    const BencodeValue* find(std::string_view key) const;
+
+    bool contains(std::string_view key) const { return is_dict() && find(key) != nullptr; }
+
+    /**
+     * @brief 字典取值，键不存在时抛出异常
+     */
+    const BencodeValue& operator[](std::string_view key) const
+    {
+        const BencodeValue* value = find(key);
+        if (value == nullptr) throw std::runtime_error("Missing bencode key: " + std::string(key));
+        return *value;
+    }
+
+private:
+    Type type_ = Type::Integer;
+    size_t size_ = 0;
+    union
+    {
+        int64_t integer_;
+        const char* string_;
+        const BencodeValue* items_;
+        const BencodeMember* members_;
+    };
+};
+
+struct BencodeMember
+{
+    std::string_view key;
+    BencodeValue value;
+};
+
+inline const BencodeValue* BencodeValue::find(std::string_view key) const
+{
+    const BencodeMember* first = members();
+    const BencodeMember* last = first + size_;
+    const BencodeMember* it = std::lower_bound(first, last, key,
+                                               [](const BencodeMember& m, std::string_view k) { return m.key < k; });
+    if (it == last || it->key != key) return nullptr;
+    return &it->value;
+}
+
+inline const BencodeValue& BencodeValue::parse(std::string_view input, size_t& pos, BencodeArena& arena, size_t max_depth)
+{
+    // 显式栈：frames 记录每个未闭合容器，子元素先压入 members，
+    // 容器闭合时整段拷进 arena 中的连续数组（两者都跟随 arena 复用）
+    std::vector<bencode_detail::ArenaFrame>& frames = arena.scratch_frames_;
+    std::vector<BencodeMember>& members = arena.scratch_members_;
+    frames.clear();
+    members.clear();
+
+    auto copy_string = [&](size_t& p) {
+        size_t len = 0;
+        size_t start = bencode_detail::parse_string_header(input, p, len);
+        char* data = len > 0 ? arena.allocate_array<char>(len) : nullptr;
+        if (len > 0) std::memcpy(data, input.data() + start, len);
+        p = start + len;
+        return std::string_view(data, len);
+    };
+
+    BencodeValue result;
+    while (true)
+    {
+        if (pos >= input.size()) throw std::runtime_error("Unexpected end of bencode input");
+        char c = input[pos];
+        BencodeValue value;
+
+        if (!frames.empty() && frames.back().dict && frames.back().expect_key && c != 'e')
+        {
+            if (!(c >= '0' && c <= '9')) throw std::runtime_error("Bencode dictionary key must be a string");
+            members.push_back(BencodeMember{copy_string(pos), BencodeValue()});
+            frames.back().expect_key = false;
+            continue;
+        }
+
+        if (c == 'e' && !frames.empty() && (!frames.back().dict || frames.back().expect_key))
+        {
+            bencode_detail::ArenaFrame frame = frames.back();
+            frames.pop_back();
+            pos++;
+            size_t n = members.size() - frame.first;
+            BencodeMember* begin = members.data() + frame.first;
+            value.size_ = n;
+            if (frame.dict)
+            {
+                // 已排序（规范编码）时只需一次线性检查；否则稳定排序后去重，后出现的键优先
+                auto not_increasing = [](const BencodeMember& a, const BencodeMember& b) { return a.key >= b.key; };
+                if (std::adjacent_find(begin, begin + n, not_increasing) != begin + n)
+                {
+                    std::stable_sort(begin, begin + n,
+                                     [](const BencodeMember& a, const BencodeMember& b) { return a.key < b.key; });
+                    size_t out = 0;
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        if (out > 0 && begin[out - 1].key == begin[i].key) begin[out - 1] = begin[i];
+                        else begin[out++] = begin[i];
+                    }
+                    n = out;
+                    value.size_ = n;
+                }
+                BencodeMember* array = arena.allocate_array<BencodeMember>(n);
+                std::copy(begin, begin + n, array);
+                value.type_ = Type::Dict;
+                value.members_ = array;
+            }
+            else
+            {
+                BencodeValue* array = arena.allocate_array<BencodeValue>(n);
+                for (size_t i = 0; i < n; i++) array[i] = begin[i].value;
+                value.type_ = Type::List;
+                value.items_ = array;
+            }
+            members.resize(frame.first);
+        }
+        else if (c >= '0' && c <= '9')
+        {
+            std::string_view s = copy_string(pos);
+            value.type_ = Type::String;
+            value.size_ = s.size();
+            value.string_ = s.data();
+        }
+        else if (c == 'i')
+        {
+            pos = bencode_detail::parse_integer(input, pos, value.integer_);
+            value.type_ = Type::Integer;
+        }
+        else if (c == 'l' || c == 'd')
+        {
+            if (frames.size() >= max_depth) throw std::runtime_error("Bencode nesting too deep");
+            frames.push_back(bencode_detail::ArenaFrame{c == 'd', c == 'd', members.size()});
+            pos++;
+            continue;
+        }
+        else
+        {
+            throw std::runtime_error("Invalid bencode value");
+        }
+
+        // 一个完整的值：挂到父容器上，或者就是根
+        if (frames.empty())
+        {
+            result = value;
+            break;
+        }
+        if (frames.back().dict)
+        {
+            members.back().value = value;
+            frames.back().expect_key = true;
+        }
+        else
+        {
+            members.push_back(BencodeMember{std::string_view(), value});
+        }
+    }
+
+    BencodeValue* root = arena.allocate_array<BencodeValue>(1);
+    *root = result;
+    return *root;
+}
+
+/**
+ * @brief 把值按 JSON 追加到 out（与 nlohmann::json::dump() 的输出一致）
+ *
+ * 字典本就按键排序；字符串必须是合法 UTF-8，控制字符转义为 \uXXXX。
+ * @throws std::runtime_error 字符串不是合法 UTF-8
+ */
+inline void append_json(std::string& out, const BencodeValue& value)
+{
+    auto append_string = [&out](std::string_view s) {
+        static const char hex[] = "0123456789abcdef";
+        out.push_back('"');
+        for (size_t i = 0; i < s.size(); i++)
+        {
+            unsigned char c = static_cast<unsigned char>(s[i]);
+            switch (c)
+            {
+                case '"': out += "\\\""; continue;
+                case '\\': out += "\\\\"; continue;
+                case '\b': out += "\\b"; continue;
+                case '\f': out += "\\f"; continue;
+                case '\n': out += "\\n"; continue;
+                case '\r': out += "\\r"; continue;
+                case '\t': out += "\\t"; continue;
+                default: break;
+            }
+            if (c < 0x20)
+            {
+                out += "\\u00";
+                out.push_back(hex[c >> 4]);
+                out.push_back(hex[c & 0x0F]);
+                continue;
+            }
+            if (c < 0x80)
+            {
+                out.push_back(static_cast<char>(c));
+                continue;
+            }
+
+            // 多字节序列：拒绝过长编码、代理区和超出 U+10FFFF 的码点
+            size_t n = 0;
+            unsigned char lo = 0x80, hi = 0xBF;
+            if (c >= 0xC2 && c <= 0xDF) n = 1;
+            else if (c == 0xE0) { n = 2; lo = 0xA0; }
+            else if (c >= 0xE1 && c <= 0xEC) n = 2;
+            else if (c == 0xED) { n = 2; hi = 0x9F; }
+            else if (c >= 0xEE && c <= 0xEF) n = 2;
+            else if (c == 0xF0) { n = 3; lo = 0x90; }
+            else if (c >= 0xF1 && c <= 0xF3) n = 3;
+            else if (c == 0xF4) { n = 3; hi = 0x8F; }
+            else throw std::runtime_error("Invalid UTF-8 in bencode string");
+
+            if (n >= s.size() - i)
+            {
+                throw std::runtime_error("Invalid UTF-8 in bencode string");
+            }
+            for (size_t k = 1; k <= n; k++)
+            {
+                unsigned char cc = static_cast<unsigned char>(s[i + k]);
+                if (cc < lo || cc > hi) throw std::runtime_error("Invalid UTF-8 in bencode string");
+                lo = 0x80;
+                hi = 0xBF;
+            }
+            out.append(s.substr(i, n + 1));
+            i += n;
+        }
+        out.push_back('"');
+    };
+
+    switch (value.type())
+    {
+        case BencodeValue::Type::String:
+            append_string(value.as_string());
+            break;
+        case BencodeValue::Type::Integer:
+            out += std::to_string(value.as_int());
+            break;
+        case BencodeValue::Type::List:
+            out.push_back('[');
+            for (size_t i = 0; i < value.size(); i++)
+            {
+                if (i > 0) out.push_back(',');
+                append_json(out, value.items()[i]);
+            }
+            out.push_back(']');
+            break;
+        case BencodeValue::Type::Dict:
+            out.push_back('{');
+            for (size_t i = 0; i < value.size(); i++)
+            {
+                if (i > 0) out.push_back(',');
+                append_string(value.members()[i].key);
+                out.push_back(':');
+                append_json(out, value.members()[i].value);
+            }
+            out.push_back('}');
+            break;
+    }
+}
+
+// ============================================================================
+// 流式（SAX）Bencode 解析
+// ============================================================================
+//
+// 输入可以任意切块 feed()：解析器是显式状态机，块边界落在长度前缀、整数或
+// 字符串内容中间都能在下一块接着解析。字符串内容以 on_string_data 分段交付，
+// 不在内部缓冲；只有字典键整体缓冲（不超过 max_key_length）。
+// 因此内存占用只与嵌套深度（每层一个栈帧）和键长有关，与输入总长度无关。
+
+/**
+ * @brief 解析事件回调；按需覆盖
+ */
+class BencodeHandler
+{
+public:
+    virtual ~BencodeHandler() = default;
+
+    virtual void on_dict_begin() {}
+    virtual void on_list_begin() {}
+    virtual void on_end() {}                          // 列表或字典结束
+    virtual void on_key(std::string_view /*key*/) {}
+    virtual void on_string_begin(uint64_t /*length*/) {}
+    virtual void on_string_data(std::string_view /*data*/) {} // 可能分多次到达
+    virtual void on_string_end() {}
+    virtual void on_int(int64_t /*value*/) {}
+};
+
+class BencodeStreamParser
+{
+public:
+    explicit BencodeStreamParser(BencodeHandler& handler, size_t max_depth = bencode_detail::max_nesting_depth,
+                                 size_t max_key_length = 64 * 1024)
+        : handler_(handler), max_depth_(max_depth), max_key_length_(max_key_length)
+    {
+    }
+
+    /**
+     * @brief 喂入下一块数据
+     *
+     * @return 本块中被消耗的字节数。顶层值在块中途结束时小于 chunk.size()，
+     *         剩余字节不属于这个值（例如 ut_metadata 消息中字典之后的 metadata）
+     * @throws std::runtime_error 格式错误、超出深度或长度限制
+     */
+    size_t feed(std::string_view chunk)
+    {
+        size_t i = 0;
+        while (i < chunk.size() && state_ != State::Done)
+        {
+            char c = chunk[i];
+            switch (state_)
+            {
+                case State::Value:
+                    start_value(c);
+                    i++;
+                    break;
+
+                case State::StringLength:
+                    i++;
+                    if (c >= '0' && c <= '9')
+                    {
+                        if (number_ > (UINT64_MAX - 9) / 10) throw std::runtime_error("Bencode string length overflow");
+                        number_ = number_ * 10 + static_cast<uint64_t>(c - '0');
+                    }
+                    else if (c == ':')
+                    {
+                        begin_string();
+                    }
+                    else
+                    {
+                        throw std::runtime_error("Invalid bencode string length");
+                    }
+                    break;
+
+                case State::StringData:
+                {
+                    size_t n = static_cast<size_t>(std::min<uint64_t>(remaining_, chunk.size() - i));
+                    std::string_view data = chunk.substr(i, n);
+                    if (string_is_key_) key_.append(data);
+                    else handler_.on_string_data(data);
+                    remaining_ -= n;
+                    i += n;
+                    if (remaining_ == 0) end_string();
+                    break;
+                }
+
+                case State::IntDigits:
+                    i++;
+                    if (c == '-' && digits_ == 0 && !negative_)
+                    {
+                        negative_ = true;
+                    }
+                    else if (c >= '0' && c <= '9')
+                    {
+                        // 前导零（"i03e"）不是规范形式
+                        if (digits_ > 0 && number_ == 0) throw std::runtime_error("Invalid bencode integer");
+                        // 以无符号累加绝对值，允许到 INT64_MIN 的绝对值
+                        uint64_t limit = negative_ ? uint64_t(1) << 63 : (uint64_t(1) << 63) - 1;
+                        uint64_t digit = static_cast<uint64_t>(c - '0');
+                        if (number_ > (limit - digit) / 10) throw std::runtime_error("Bencode integer overflow");
+                        number_ = number_ * 10 + digit;
+                        digits_++;
+                    }
+                    else if (c == 'e' && digits_ > 0 && !(negative_ && number_ == 0)) // "i-0e" 非法
+                    {
+                        int64_t value = negative_ ? static_cast<int64_t>(0 - number_) : static_cast<int64_t>(number_);
+                        handler_.on_int(value);
+                        end_value();
+                    }
+                    else
+                    {
+                        throw std::runtime_error("Invalid bencode integer");
+                    }
+                    break;
+
+                case State::Done:
+                    break;
+            }
+        }
+        return i;
+    }
+
+    /**
+     * @brief 顶层值是否已完整解析
+     */
+    bool done() const { return state_ == State::Done; }
+
+private:
+    enum class State
+    {
+        Value,        // 等待下一个值（或容器结尾 'e'）
+        StringLength, // 读取字符串长度前缀
+        StringData,   // 读取字符串内容
+        IntDigits,    // 读取整数
+        Done,
+    };
+
+    struct Frame
+    {
+        bool dict;
+        bool expect_key; // 字典中下一个元素是键
+    };
+
+    void start_value(char c)
+    {
+        bool key_position = !stack_.empty() && stack_.back().dict && stack_.back().expect_key;
+
+        if (c == 'e')
+        {
+            if (stack_.empty() || (stack_.back().dict && !stack_.back().expect_key))
+            {
+                throw std::runtime_error("Unexpected bencode 'e'");
+            }
+            stack_.pop_back();
+            handler_.on_end();
+            end_value();
+            return;
+        }
+        if (key_position && !(c >= '0' && c <= '9'))
+        {
+            throw std::runtime_error("Bencode dictionary key must be a string");
+        }
+
+        if (c >= '0' && c <= '9')
+        {
+            string_is_key_ = key_position;
+            number_ = static_cast<uint64_t>(c - '0');
+            state_ = State::StringLength;
+        }
+        else if (c == 'i')
+        {
+            number_ = 0;
+            digits_ = 0;
+            negative_ = false;
+            state_ = State::IntDigits;
+        }
+        else if (c == 'l' || c == 'd')
+        {
+            if (stack_.size() >= max_depth_) throw std::runtime_error("Bencode nesting too deep");
+            stack_.push_back(Frame{c == 'd', c == 'd'});
+            if (c == 'd') handler_.on_dict_begin();
+            else handler_.on_list_begin();
+        }
+        else
+        {
+            throw std::runtime_error("Invalid bencode value");
+        }
+    }
+
+    void begin_string()
+    {
+        remaining_ = number_;
+        if (string_is_key_)
+        {
+            if (remaining_ > max_key_length_) throw std::runtime_error("Bencode dictionary key too long");
+            key_.clear();
+        }
+        else
+        {
+            handler_.on_string_begin(remaining_);
+        }
+        state_ = State::StringData;
+        if (remaining_ == 0) end_string();
+    }
+
+    void end_string()
+    {
+        if (string_is_key_)
+        {
+            handler_.on_key(key_);
+            stack_.back().expect_key = false;
+            state_ = State::Value;
+        }
+        else
+        {
+            handler_.on_string_end();
+            end_value();
+        }
+    }
+
+    /**
+     * @brief 一个完整的值结束：回到父容器，或整个输入结束
+     */
+    void end_value()
+    {
+        if (stack_.empty())
+        {
+            state_ = State::Done;
+            return;
+        }
+        if (stack_.back().dict) stack_.back().expect_key = true;
+        state_ = State::Value;
+    }
+
+    BencodeHandler& handler_;
+    const size_t max_depth_;
+    const size_t max_key_length_;
+
+    State state_ = State::Value;
+    std::vector<Frame> stack_;
+    uint64_t number_ = 0;     // 字符串长度 / 整数绝对值
+    uint64_t remaining_ = 0;  // 当前字符串还差多少字节
+    int digits_ = 0;
+    bool negative_ = false;
+    bool string_is_key_ = false;
+    std::string key_;
+};
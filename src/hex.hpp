@@ -0,0 +1,184 @@
+/**
+ * @file hex.hpp
+ * @brief 十六进制编解码
+ *
+ * 编码：x86 上有 SSSE3 时用 pshufb 查表，一次把 16 字节展开为 32 个字符；
+ * 其余部分（及非 x86 平台）用 256 项的双字符查找表，每字节一次查表。
+ * 解码：256 项查找表把字符映射为 0-15（非法字符为 -1），两两合并，不做任何字符串分配。
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HEX_HAVE_X86 1
+#else
+#define HEX_HAVE_X86 0
+#endif
+
+namespace hex_detail
+{
+
+/**
+ * @brief 字节 -> 两个小写十六进制字符
+ */
+struct EncodeTable
+{
+    char pairs[256][2];
+
+    constexpr EncodeTable() : pairs()
+    {
+        const char digits[] = "0123456789abcdef";
+        for (int i = 0; i < 256; i++)
+        {
+            pairs[i][0] = digits[i >> 4];
+            pairs[i][1] = digits[i & 0x0F];
+        }
+    }
+};
+
+/**
+ * @brief 字符 -> 0-15，非十六进制字符为 -1（大小写均可）
+ */
+struct DecodeTable
+{
+    int8_t values[256];
+
+    constexpr DecodeTable() : values()
+    {
+        for (int i = 0; i < 256; i++) values[i] = -1;
+        for (int i = 0; i < 10; i++) values['0' + i] = static_cast<int8_t>(i);
+        for (int i = 0; i < 6; i++)
+        {
+            values['a' + i] = static_cast<int8_t>(10 + i);
+            values['A' + i] = static_cast<int8_t>(10 + i);
+        }
+    }
+};
+
+inline constexpr EncodeTable encode_table{};
+inline constexpr DecodeTable decode_table{};
+
+inline void encode_scalar(const uint8_t* in, size_t len, char* out)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        std::memcpy(out + 2 * i, encode_table.pairs[in[i]], 2);
+    }
+}
+
+#if HEX_HAVE_X86
+/**
+ * @brief SSSE3：高/低半字节分别经 pshufb 查表，再交错成 "hl hl ..." 顺序
+ *
+ * @return 已处理的字节数（16 的倍数）
+ */
+__attribute__((target("ssse3")))
+inline size_t encode_ssse3(const uint8_t* in, size_t len, char* out)
+{
+    const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                                         '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m128i mask = _mm_set1_epi8(0x0F);
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        __m128i lo = _mm_and_si128(v, mask);
+        __m128i hi_chars = _mm_shuffle_epi8(digits, hi);
+        __m128i lo_chars = _mm_shuffle_epi8(digits, lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), _mm_unpacklo_epi8(hi_chars, lo_chars));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i + 16), _mm_unpackhi_epi8(hi_chars, lo_chars));
+    }
+    return i;
+}
+
+inline bool cpu_has_ssse3()
+{
+    static const bool has = __builtin_cpu_supports("ssse3");
+    return has;
+}
+#endif
+
+} // namespace hex_detail
+
+/**
+ * @brief 把 len 字节编码为 2*len 个小写十六进制字符写入 out（不追加 '\0'）
+ */
+inline void hex_encode(const uint8_t* in, size_t len, char* out)
+{
+    size_t done = 0;
+#if HEX_HAVE_X86
+    if (len >= 16 && hex_detail::cpu_has_ssse3())
+    {
+        done = hex_detail::encode_ssse3(in, len, out);
+    }
+#endif
+    hex_detail::encode_scalar(in + done, len - done, out + 2 * done);
+}
+
+/**
+ * @brief 把 2*out_len 个十六进制字符解码为 out_len 字节
+ *
+ * @return 遇到非十六进制字符时返回 false
+ */
+inline bool hex_decode(const char* in, size_t out_len, uint8_t* out)
+{
+    const int8_t* table = hex_detail::decode_table.values;
+    int acc = 0; // 任一字符非法时符号位被置上
+    for (size_t i = 0; i < out_len; i++)
+    {
+        int hi = table[static_cast<unsigned char>(in[2 * i])];
+        int lo = table[static_cast<unsigned char>(in[2 * i + 1])];
+        acc |= hi | lo;
+        out[i] = static_cast<uint8_t>((hi << 4) | (lo & 0x0F));
+    }
+    return acc >= 0;
+}
+
+/**
+ * @brief 把 data 的十六进制表示追加到 out 末尾
+ */
+inline void append_hex(std::string& out, std::string_view data)
+{
+    size_t pos = out.size();
+    out.resize(pos + data.size() * 2);
+    hex_encode(reinterpret_cast<const uint8_t*>(data.data()), data.size(), &out[pos]);
+}
+
+/**
+ * @brief 将二进制字符串转换为十六进制字符串
+ * @param binary 二进制数据
+ * @return 十六进制字符串（小写）
+ */
+inline std::string to_hex(std::string_view binary)
+{
+    std::string hex;
+    append_hex(hex, binary);
+    return hex;
+}
+
+/**
+ * @brief 将十六进制字符串转换为二进制数据
+ * @param hex 十六进制字符串（如 "d69f91e6..."，大小写均可）
+ * @return std::string 二进制数据
+ * @throws std::runtime_error 长度为奇数或含非十六进制字符
+ */
+inline std::string from_hex(std::string_view hex)
+{
+    if (hex.size() % 2 != 0) throw std::runtime_error("Invalid hex string length");
+
+    std::string binary(hex.size() / 2, '\0');
+    if (!hex_decode(hex.data(), binary.size(), reinterpret_cast<uint8_t*>(&binary[0])))
+    {
+        throw std::runtime_error("Invalid hex string");
+    }
+    return binary;
+}
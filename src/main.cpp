@@ -92,6 +92,17 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <array>
+#include <deque>
+#include <string_view>
+#include <functional>
+#include <cmath>
+#include <limits>
+#include <cerrno>
 
 
 
@@ -102,6 +113,10 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define SOCKET int
 #define INVALID_SOCKET -1
@@ -110,468 +125,17 @@
 
 
 #include "lib/nlohmann/json.hpp"
+#include "sha1.hpp"
+#include "sha256.hpp"
+#include "hex.hpp"
+#include "bencode.hpp"
+#include "torrent.hpp"
+#include "peer_wire.hpp"
+#include "piece_merkle.hpp"
+#include "pipeline_depth.hpp"
 
 using json = nlohmann::json;
 
-// ============================================================================
-// SHA-1 哈希算法实现
-// ============================================================================
-// SHA-1 (Secure Hash Algorithm 1) 产生 160 位 (20 字节) 的哈希值
-// 用于计算 torrent 文件的 Info Hash
-
-/**
- * @brief SHA-1 哈希计算类
- * 
- * 实现 SHA-1 算法，用于计算 info 字典的哈希值
- */
-class SHA1 
-{
-public:
-    SHA1() { reset(); }
-    
-    /**
-     * @brief 更新哈希计算，添加更多数据
-     * @param data 要添加的数据
-     * @param len 数据长度
-     */
-    void update(const uint8_t* data, size_t len)
-    {
-        size_t i = 0;
-        size_t index = (count[0] >> 3) & 0x3F;
-        
-        count[0] += static_cast<uint32_t>(len << 3);
-        if (count[0] < (len << 3)) count[1]++;
-        count[1] += static_cast<uint32_t>(len >> 29);
-        
-        size_t partLen = 64 - index;
-        
-        if (len >= partLen) 
-        {
-            std::memcpy(&buffer[index], data, partLen);
-            transform(buffer);
-            
-            for (i = partLen; i + 63 < len; i += 64)
-                transform(&data[i]);
-            
-            index = 0;
-        }
-        
-        std::memcpy(&buffer[index], &data[i], len - i);
-    }
-    
-    void update(const std::string& s)
-    {
-        update(reinterpret_cast<const uint8_t*>(s.c_str()), s.size());
-    }
-    
-    /**
-     * @brief 完成哈希计算并返回结果
-     * @return 20 字节的 SHA-1 哈希值
-     */
-    std::string final()
-    {
-        uint8_t finalcount[8];
-        for (uint32_t i = 0; i < 8; i++)
-            finalcount[i] = static_cast<uint8_t>((count[(i >= 4 ? 0 : 1)] >> ((3 - (i & 3)) * 8)) & 255);
-        
-        uint8_t c = 0x80;
-        update(&c, 1);
-        
-        while ((count[0] & 504) != 448)
-        {
-            c = 0x00;
-            update(&c, 1);
-        }
-        
-        update(finalcount, 8);
-        
-        std::string hash(20, '\0');
-        for (uint32_t i = 0; i < 20; i++)
-            hash[i] = static_cast<char>((state[i >> 2] >> ((3 - (i & 3)) * 8)) & 255);
-        
-        reset();
-        return hash;
-    }
-    
-    /**
-     * @brief 便捷函数：计算字符串的 SHA-1 哈希
-     * @param s 输入字符串
-     * @return 20 字节的 SHA-1 哈希值
-     */
-    static std::string hash(const std::string& s)
-    {
-        SHA1 sha1;
-        sha1.update(s);
-        return sha1.final();
-    }
-
-private:
-    uint32_t state[5];
-    uint32_t count[2];
-    uint8_t buffer[64];
-    
-    void reset()
-    {
-        state[0] = 0x67452301;
-        state[1] = 0xEFCDAB89;
-        state[2] = 0x98BADCFE;
-        state[3] = 0x10325476;
-        state[4] = 0xC3D2E1F0;
-        count[0] = count[1] = 0;
-    }
-    
-    static uint32_t rol(uint32_t value, uint32_t bits)
-    {
-        return (value << bits) | (value >> (32 - bits));
-    }
-    
-    static uint32_t blk(const uint32_t* block, uint32_t i)
-    {
-        return rol(block[(i + 13) & 15] ^ block[(i + 8) & 15] ^ block[(i + 2) & 15] ^ block[i], 1);
-    }
-    
-    static void R0(const uint32_t* block, uint32_t v, uint32_t& w, uint32_t x, uint32_t y, uint32_t& z, uint32_t i)
-    {
-        z += ((w & (x ^ y)) ^ y) + block[i] + 0x5A827999 + rol(v, 5);
-        w = rol(w, 30);
-    }
-    
-    static void R1(uint32_t* block, uint32_t v, uint32_t& w, uint32_t x, uint32_t y, uint32_t& z, uint32_t i)
-    {
-        block[i] = blk(block, i);
-        z += ((w & (x ^ y)) ^ y) + block[i] + 0x5A827999 + rol(v, 5);
-        w = rol(w, 30);
-    }
-    
-    static void R2(uint32_t* block, uint32_t v, uint32_t& w, uint32_t x, uint32_t y, uint32_t& z, uint32_t i)
-    {
-        block[i] = blk(block, i);
-        z += (w ^ x ^ y) + block[i] + 0x6ED9EBA1 + rol(v, 5);
-        w = rol(w, 30);
-    }
-    
-    static void R3(uint32_t* block, uint32_t v, uint32_t& w, uint32_t x, uint32_t y, uint32_t& z, uint32_t i)
-    {
-        block[i] = blk(block, i);
-        z += (((w | x) & y) | (w & x)) + block[i] + 0x8F1BBCDC + rol(v, 5);
-        w = rol(w, 30);
-    }
-    
-    static void R4(uint32_t* block, uint32_t v, uint32_t& w, uint32_t x, uint32_t y, uint32_t& z, uint32_t i)
-    {
-        block[i] = blk(block, i);
-        z += (w ^ x ^ y) + block[i] + 0xCA62C1D6 + rol(v, 5);
-        w = rol(w, 30);
-    }
-    
-    void transform(const uint8_t* data)
-    {
-        uint32_t block[16];
-        for (uint32_t i = 0; i < 16; i++)
-            block[i] = (data[i * 4] << 24) | (data[i * 4 + 1] << 16) | (data[i * 4 + 2] << 8) | data[i * 4 + 3];
-        
-        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
-        
-        R0(block, a, b, c, d, e, 0);  R0(block, e, a, b, c, d, 1);  R0(block, d, e, a, b, c, 2);  R0(block, c, d, e, a, b, 3);
-        R0(block, b, c, d, e, a, 4);  R0(block, a, b, c, d, e, 5);  R0(block, e, a, b, c, d, 6);  R0(block, d, e, a, b, c, 7);
-        R0(block, c, d, e, a, b, 8);  R0(block, b, c, d, e, a, 9);  R0(block, a, b, c, d, e, 10); R0(block, e, a, b, c, d, 11);
-        R0(block, d, e, a, b, c, 12); R0(block, c, d, e, a, b, 13); R0(block, b, c, d, e, a, 14); R0(block, a, b, c, d, e, 15);
-        R1(block, e, a, b, c, d, 0);  R1(block, d, e, a, b, c, 1);  R1(block, c, d, e, a, b, 2);  R1(block, b, c, d, e, a, 3);
-        R2(block, a, b, c, d, e, 4);  R2(block, e, a, b, c, d, 5);  R2(block, d, e, a, b, c, 6);  R2(block, c, d, e, a, b, 7);
-        R2(block, b, c, d, e, a, 8);  R2(block, a, b, c, d, e, 9);  R2(block, e, a, b, c, d, 10); R2(block, d, e, a, b, c, 11);
-        R2(block, c, d, e, a, b, 12); R2(block, b, c, d, e, a, 13); R2(block, a, b, c, d, e, 14); R2(block, e, a, b, c, d, 15);
-        R2(block, d, e, a, b, c, 0);  R2(block, c, d, e, a, b, 1);  R2(block, b, c, d, e, a, 2);  R2(block, a, b, c, d, e, 3);
-        R2(block, e, a, b, c, d, 4);  R2(block, d, e, a, b, c, 5);  R2(block, c, d, e, a, b, 6);  R2(block, b, c, d, e, a, 7);
-        R3(block, a, b, c, d, e, 8);  R3(block, e, a, b, c, d, 9);  R3(block, d, e, a, b, c, 10); R3(block, c, d, e, a, b, 11);
-        R3(block, b, c, d, e, a, 12); R3(block, a, b, c, d, e, 13); R3(block, e, a, b, c, d, 14); R3(block, d, e, a, b, c, 15);
-        R3(block, c, d, e, a, b, 0);  R3(block, b, c, d, e, a, 1);  R3(block, a, b, c, d, e, 2);  R3(block, e, a, b, c, d, 3);
-        R3(block, d, e, a, b, c, 4);  R3(block, c, d, e, a, b, 5);  R3(block, b, c, d, e, a, 6);  R3(block, a, b, c, d, e, 7);
-        R3(block, e, a, b, c, d, 8);  R3(block, d, e, a, b, c, 9);  R3(block, c, d, e, a, b, 10); R3(block, b, c, d, e, a, 11);
-        R4(block, a, b, c, d, e, 12); R4(block, e, a, b, c, d, 13); R4(block, d, e, a, b, c, 14); R4(block, c, d, e, a, b, 15);
-        R4(block, b, c, d, e, a, 0);  R4(block, a, b, c, d, e, 1);  R4(block, e, a, b, c, d, 2);  R4(block, d, e, a, b, c, 3);
-        R4(block, c, d, e, a, b, 4);  R4(block, b, c, d, e, a, 5);  R4(block, a, b, c, d, e, 6);  R4(block, e, a, b, c, d, 7);
-        R4(block, d, e, a, b, c, 8);  R4(block, c, d, e, a, b, 9);  R4(block, b, c, d, e, a, 10); R4(block, a, b, c, d, e, 11);
-        R4(block, e, a, b, c, d, 12); R4(block, d, e, a, b, c, 13); R4(block, c, d, e, a, b, 14); R4(block, b, c, d, e, a, 15);
-        
-        state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e;
-    }
-};
-
-/**
- * @brief 将二进制字符串转换为十六进制字符串
- * @param binary 二进制数据
- * @return 十六进制字符串（小写）
- */
-std::string to_hex(const std::string& binary)
-{
-    std::ostringstream ss;
-    ss << std::hex << std::setfill('0');
-    for (unsigned char c : binary)
-    {
-        ss << std::setw(2) << static_cast<int>(c);
-    }
-    return ss.str();
-}
-
-/**
- * @brief 将十六进制字符串转换为二进制数据
- * @param hex 十六进制字符串（如 "d69f91e6..."）
- * @return std::string 二进制数据
- */
-std::string from_hex(const std::string& hex)
-{
-    std::string binary;
-    binary.reserve(hex.size() / 2);
-    
-    for (size_t i = 0; i + 1 < hex.size(); i += 2)
-    {
-        std::string byte_str = hex.substr(i, 2);
-        char byte = static_cast<char>(std::stoi(byte_str, nullptr, 16));
-        binary.push_back(byte);
-    }
-    
-    return binary;
-}
-
-/**
- * @brief 解码 Bencode 编码的值（带位置跟踪）
- * 
- * Bencode 支持四种数据类型：
- * 1. 字符串 (Strings): 格式为 "<长度>:<内容>"，例如 "5:hello" 表示字符串 "hello"
- * 2. 整数 (Integers): 格式为 "i<数字>e"，例如 "i52e" 表示整数 52，"i-52e" 表示 -52
- * 3. 列表 (Lists): 格式为 "l<元素>e"，例如 "l5:helloi52ee" 表示 ["hello", 52]
- * 4. 字典 (Dictionaries): 格式为 "d<键值对>e"，例如 "d3:foo3:bare" 表示 {"foo":"bar"}
- * 
- * @param encoded_value Bencode 编码的字符串
- * @param pos 当前解析位置（引用，会被更新为解析结束后的位置）
- * @return json 解码后的 JSON 对象
- * @throws std::runtime_error 当遇到无效或不支持的编码格式时抛出异常
- */
-json decode_bencoded_value(const std::string& encoded_value, size_t& pos) 
-{
-    // 检查第一个字符是否为数字，判断是否为字符串类型
-    // Bencode 字符串以长度数字开头（0-9）
-    if (std::isdigit(encoded_value[pos])) 
-    {
-        // ================================================================
-        // 解码 Bencode 字符串
-        // ================================================================
-        // 格式: "<长度>:<字符串内容>"
-        // 
-        // 解析示例: "5:hello"
-        //   - "5" 是长度（表示后面有 5 个字符）
-        //   - ":" 是分隔符
-        //   - "hello" 是实际内容
-        // 
-        // 解析步骤:
-        //   1. 找到冒号位置 -> colon_index = 1
-        //   2. 提取长度字符串 "5" -> length = 5
-        //   3. 从冒号后提取 5 个字符 -> "hello"
-        //   4. 更新 pos 到字符串末尾之后
-        
-        // 查找冒号分隔符的位置（从当前位置开始搜索）
-        size_t colon_index = encoded_value.find(':', pos);
-        
-        if (colon_index != std::string::npos) 
-        {
-            // 提取长度部分（当前位置到冒号之间的数字字符串）
-            // 例如: pos=0, colon_index=1, 则提取 substr(0, 1) = "5"
-            std::string number_string = encoded_value.substr(pos, colon_index - pos);
-            
-            // 将长度字符串转换为 64 位整数
-            // 使用 atoll 处理可能的大数值
-            int64_t length = std::atoll(number_string.c_str());
-            
-            // 提取实际字符串内容（从冒号后开始，长度为 length）
-            // 例如: colon_index=1, length=5, 则提取 substr(2, 5) = "hello"
-            std::string str = encoded_value.substr(colon_index + 1, length);
-            
-            // 更新位置：冒号位置 + 1（冒号本身）+ 字符串长度
-            // 例如: pos = 1 + 1 + 5 = 7，指向 "5:hello" 之后的位置
-            pos = colon_index + 1 + length;
-            
-            // 将字符串包装为 JSON 对象并返回
-            return json(str);
-        } 
-        else 
-        {
-            // 字符串格式错误：缺少冒号分隔符
-            throw std::runtime_error("Invalid encoded value: " + encoded_value);
-        }
-    } 
-    else if (encoded_value[pos] == 'i')
-    {
-        // ================================================================
-        // 解码 Bencode 整数
-        // ================================================================
-        // 格式: "i<数字>e"
-        // 
-        // 解析示例: "i52e"
-        //   - "i" 是起始标记
-        //   - "52" 是数字内容
-        //   - "e" 是结束标记
-        // 
-        // 解析步骤:
-        //   1. 跳过 'i'，从 pos+1 开始
-        //   2. 找到 'e' 的位置 -> end_index
-        //   3. 提取 'i' 和 'e' 之间的数字字符串
-        //   4. 转换为整数
-        //   5. 更新 pos 到 'e' 之后
-        
-        // 查找结束标记 'e' 的位置（从当前位置开始搜索）
-        size_t end_index = encoded_value.find('e', pos);
-        
-        if (end_index != std::string::npos)
-        {
-            // 提取数字部分（'i' 和 'e' 之间的内容）
-            // 例如: "i52e", pos=0, end_index=3
-            //       substr(0+1, 3-0-1) = substr(1, 2) = "52"
-            std::string number_string = encoded_value.substr(pos + 1, end_index - pos - 1);
-            
-            // 将数字字符串转换为 64 位整数
-            // 支持正数、负数和零
-            int64_t number = std::atoll(number_string.c_str());
-            
-            // 更新位置：跳过结束标记 'e'
-            // 例如: pos = 3 + 1 = 4，指向 "i52e" 之后的位置
-            pos = end_index + 1;
-            
-            // 将整数包装为 JSON 对象并返回
-            return json(number);
-        }
-        else
-        {
-            // 整数格式错误：缺少结束标记 'e'
-            throw std::runtime_error("Invalid encoded integer: " + encoded_value);
-        }
-    }
-    else if (encoded_value[pos] == 'l')
-    {
-        // ================================================================
-        // 解码 Bencode 列表
-        // ================================================================
-        // 格式: "l<元素1><元素2>...e"
-        // 
-        // 解析示例: "l5:helloi52ee" -> ["hello", 52]
-        //   - "l" 是起始标记
-        //   - "5:hello" 是第一个元素（字符串）
-        //   - "i52e" 是第二个元素（整数）
-        //   - "e" 是结束标记
-        // 
-        // 解析步骤:
-        //   1. 跳过 'l'
-        //   2. 循环: 检查当前字符是否为 'e'
-        //      - 如果不是 'e'，递归解析下一个元素
-        //      - pos 会被递归调用自动更新
-        //   3. 遇到 'e' 时退出循环，跳过 'e'
-        // 
-        // 位置变化示例 "l5:helloi52ee":
-        //   pos=0 -> 看到 'l', pos++ -> pos=1
-        //   pos=1 -> 解析 "5:hello" -> pos=8
-        //   pos=8 -> 解析 "i52e" -> pos=12
-        //   pos=12 -> 看到 'e', 退出循环, pos++ -> pos=13
-        
-        // 跳过列表起始标记 'l'
-        pos++;
-        
-        // 创建 JSON 数组来存储列表元素
-        json list = json::array();
-        
-        // 循环解析列表中的每个元素，直到遇到结束标记 'e'
-        while (encoded_value[pos] != 'e')
-        {
-            // 递归调用解码函数解析下一个元素
-            // 关键: pos 是引用传递，递归调用后会自动更新到该元素之后的位置
-            // 这样下一次循环就能从正确的位置继续解析
-            list.push_back(decode_bencoded_value(encoded_value, pos));
-        }
-        
-        // 跳过列表结束标记 'e'
-        pos++;
-        
-        return list;
-    }
-    else if (encoded_value[pos] == 'd')
-    {
-        // ================================================================
-        // 解码 Bencode 字典
-        // ================================================================
-        // 格式: "d<key1><value1><key2><value2>...e"
-        // 
-        // 解析示例: "d3:foo3:bar5:helloi52ee" -> {"foo":"bar","hello":52}
-        // 
-        // 编码结构分解:
-        //   d        -> 字典起始标记
-        //   3:foo    -> 键1: 字符串 "foo" (长度=3)
-        //   3:bar    -> 值1: 字符串 "bar" (长度=3)
-        //   5:hello  -> 键2: 字符串 "hello" (长度=5)
-        //   i52e     -> 值2: 整数 52
-        //   e        -> 字典结束标记
-        // 
-        // 解析步骤详解:
-        //   | 步骤 | pos | 当前字符 | 操作                      | 结果              |
-        //   |-----|-----|---------|--------------------------|------------------|
-        //   | 1   | 0   | 'd'     | 识别为字典，pos++          | 进入字典解析       |
-        //   | 2   | 1   | '3'     | 递归解析字符串 "3:foo"     | key="foo", pos=6 |
-        //   | 3   | 6   | '3'     | 递归解析字符串 "3:bar"     | val="bar", pos=11|
-        //   | 4   | 11  | '5'     | 递归解析字符串 "5:hello"   | key="hello",pos=18|
-        //   | 5   | 18  | 'i'     | 递归解析整数 "i52e"        | val=52, pos=22   |
-        //   | 6   | 22  | 'e'     | 遇到结束标记，退出循环      | 返回字典          |
-        // 
-        // 关键点:
-        //   - 键必须是字符串类型
-        //   - 键按字典序排列（Bencode 规范要求）
-        //   - 值可以是任意 Bencode 类型（字符串、整数、列表、字典）
-        //   - pos 是引用传递，每次递归调用后自动更新位置
-        
-        // 跳过字典起始标记 'd'
-        pos++;
-        
-        // 创建 JSON 对象来存储键值对
-        json dict = json::object();
-        
-        // 循环解析字典中的每个键值对，直到遇到结束标记 'e'
-        while (encoded_value[pos] != 'e')
-        {
-            // 第一步: 解析键（键必须是字符串类型）
-            // 递归调用解码函数，pos 会被自动更新到键之后的位置
-            json key = decode_bencoded_value(encoded_value, pos);
-            
-            // 第二步: 解析值（值可以是任意 Bencode 类型）
-            // 再次递归调用，pos 继续更新到值之后的位置
-            json value = decode_bencoded_value(encoded_value, pos);
-            
-            // 第三步: 将键值对添加到字典中
-            // key.get<std::string>() 将 JSON 字符串转换为 C++ string 作为键
-            dict[key.get<std::string>()] = value;
-        }
-        
-        // 跳过字典结束标记 'e'
-        pos++;
-        
-        return dict;
-    }
-    else 
-    {
-        // 遇到未知的编码类型
-        throw std::runtime_error("Unhandled encoded value: " + encoded_value);
-    }
-}
-
-/**
- * @brief 解码 Bencode 编码的值（便捷包装函数）
- * 
- * 这是一个便捷的包装函数，内部创建位置变量并调用带位置跟踪的解码函数。
- * 
- * @param encoded_value Bencode 编码的字符串
- * @return json 解码后的 JSON 对象
- */
-json decode_bencoded_value(const std::string& encoded_value) 
-{
-    size_t pos = 0;
-    return decode_bencoded_value(encoded_value, pos);
-}
-
 /**
  * @brief 读取文件内容为字符串
  * 
@@ -595,39 +159,6 @@ std::string read_file(const std::string& file_path)
     return ss.str();
 }
 
-/**
- * @brief 从 torrent 文件内容中提取 info 字典的原始 Bencode 数据
- * 
- * Info Hash 需要对 info 字典的原始 Bencode 编码数据计算 SHA-1，
- * 而不是对解析后再重新编码的数据计算。因此需要直接从原始文件中提取。
- * 
- * @param file_content torrent 文件的完整内容
- * @return std::string info 字典的原始 Bencode 编码数据
- */
-std::string extract_info_dict(const std::string& file_content)
-{
-    // 查找 "4:info" 键的位置
-    // 在 Bencode 中，"info" 键编码为 "4:info"
-    std::string info_key = "4:info";
-    size_t info_pos = file_content.find(info_key);
-    
-    if (info_pos == std::string::npos)
-    {
-        throw std::runtime_error("Could not find info dictionary in torrent file");
-    }
-    
-    // info 字典的起始位置（跳过 "4:info" 键）
-    size_t dict_start = info_pos + info_key.length();
-    
-    // 使用解码函数来确定 info 字典的结束位置
-    // 通过 pos 引用参数，解码完成后 pos 会指向字典结束后的位置
-    size_t pos = dict_start;
-    decode_bencoded_value(file_content, pos);
-    
-    // 提取 info 字典的原始 Bencode 数据
-    return file_content.substr(dict_start, pos - dict_start);
-}
-
 // ============================================================================
 // URL 编码和 HTTP 请求功能
 // ============================================================================
@@ -894,12 +425,15 @@ void parse_url(const std::string& url, std::string& host, int& port, std::string
 }
 
 /**
- * @brief 发送 HTTP GET 请求并返回响应体
- * 
+ * @brief 发送 HTTP GET 请求，响应体边接收边交给 on_body
+ *
+ * 只缓冲到响应头结束（\r\n\r\n）为止；之后每次 recv 到的数据直接回调，
+ * 调用方可以用流式解析器边收边处理，不必先把整个响应体攒在内存里。
+ *
  * @param url 请求的 URL（包含查询参数）
- * @return std::string HTTP 响应体
+ * @param on_body 响应体数据块回调（可能被调用零次或多次）
  */
-std::string http_get(const std::string& url)
+void http_get_stream(const std::string& url, const std::function<void(std::string_view)>& on_body)
 {
     std::string host, path;
     int port;
@@ -950,26 +484,43 @@ std::string http_get(const std::string& url)
     }
     
     // 接收响应
-    std::string response;
+    // HTTP 响应头和响应体之间用 \r\n\r\n 分隔；头部收齐之前先缓冲
+    std::string header;
+    bool in_body = false;
     char buffer[4096];
     int bytes_received;
-    
-    while ((bytes_received = recv(sock, buffer, sizeof(buffer), 0)) > 0)
+
+    try
     {
-        response.append(buffer, bytes_received);
+        while ((bytes_received = recv(sock, buffer, sizeof(buffer), 0)) > 0)
+        {
+            std::string_view chunk(buffer, static_cast<size_t>(bytes_received));
+            if (!in_body)
+            {
+                // 分隔符可能跨两次 recv，从上次末尾往前 3 字节开始找
+                size_t search_from = header.size() >= 3 ? header.size() - 3 : 0;
+                header.append(chunk);
+                size_t body_start = header.find("\r\n\r\n", search_from);
+                if (body_start == std::string::npos) continue;
+
+                in_body = true;
+                chunk = std::string_view(header).substr(body_start + 4);
+            }
+            if (!chunk.empty()) on_body(chunk);
+        }
+    }
+    catch (...)
+    {
+        closesocket(sock);
+        throw;
     }
 
     closesocket(sock);
 
-    // 解析 HTTP 响应，提取响应体
-    // HTTP 响应头和响应体之间用 \r\n\r\n 分隔
-    size_t body_start = response.find("\r\n\r\n");
-    if (body_start == std::string::npos)
+    if (!in_body)
     {
         throw std::runtime_error("Invalid HTTP response");
     }
-    
-    return response.substr(body_start + 4);
 }
 
 // ============================================================================
@@ -1025,150 +576,301 @@ void send_all(SOCKET sock, const std::string& data)
     }
 }
 
-/**
- * @brief 接收指定长度的字节数（不够则循环接收）
- */
-std::string recv_exact(SOCKET sock, size_t length)
-{
-    std::string out;
-    out.resize(length);
-
-    size_t total = 0;
-    while (total < length)
-    {
-        int received = recv(sock, &out[total], static_cast<int>(length - total), 0);
-        if (received == SOCKET_ERROR)
-        {
-            throw std::runtime_error("Failed to receive data");
-        }
-        if (received == 0)
-        {
-            throw std::runtime_error("Peer closed connection");
-        }
-        total += static_cast<size_t>(received);
-    }
-
-    return out;
-}
-
 // ============================================================================
 // Peer Message 编解码（下载 piece 用）
 // ============================================================================
 
-uint32_t read_u32_be(const std::string& buf, size_t offset)
-{
-    return (static_cast<uint32_t>(static_cast<unsigned char>(buf[offset])) << 24) |
-           (static_cast<uint32_t>(static_cast<unsigned char>(buf[offset + 1])) << 16) |
-           (static_cast<uint32_t>(static_cast<unsigned char>(buf[offset + 2])) << 8) |
-           (static_cast<uint32_t>(static_cast<unsigned char>(buf[offset + 3])));
-}
-
-void append_u32_be(std::string& out, uint32_t value)
-{
-    out.push_back(static_cast<char>((value >> 24) & 0xFF));
-    out.push_back(static_cast<char>((value >> 16) & 0xFF));
-    out.push_back(static_cast<char>((value >> 8) & 0xFF));
-    out.push_back(static_cast<char>(value & 0xFF));
-}
-
 struct PeerMessage
 {
     uint32_t length = 0; // 不含自身 4 字节前缀
     bool keepalive = false;
     uint8_t id = 0;
-    std::string payload;
+    std::string_view payload; // 指向 PeerConnection 的接收缓冲区，下一次读取前有效
 };
 
-PeerMessage recv_peer_message(SOCKET sock)
+/**
+ * @brief 一个 peer 连接：接收缓冲区 + 发送队列
+ *
+ * 每次 recv 都尽量读满缓冲区的空闲部分（通常一次就包含多条消息），之后逐条切出完整消息，
+ * 直到剩余数据不足一条才再次 recv；消息以 string_view 的形式指向缓冲区，不做拷贝。
+ * 缓冲区不环绕：尾部放不下下一条消息时，把未消费的部分移回开头，保证每条消息在内存中连续；
+ * 超过缓冲区大小的消息会让缓冲区扩容（上限 max_message_length）。
+ *
+ * piece 消息可以只缓冲头部：next_message(7, 8) 只读入 index/begin，block 数据（body）
+ * 由 read_body() 直接从 socket 收进调用方的 piece 缓冲区，已在接收缓冲区里的部分拷贝一次。
+ *
+ * 发送的消息先编码进一个复用的发送缓冲区（clear 后保留容量，稳定后不再分配），
+ * 在下一次阻塞的 recv 之前（或显式 flush()）一次 send 发出：流水线一轮发出的所有 request
+ * 只需一次系统调用。
+ *
+ * 不持有 socket，关闭仍由调用方负责。
+ */
+class PeerConnection
 {
-    PeerMessage msg;
-    std::string len_bytes = recv_exact(sock, 4);
-    msg.length = read_u32_be(len_bytes, 0);
+public:
+    static constexpr size_t default_buffer_size = 256 * 1024;
+    static constexpr uint32_t max_message_length = 16 * 1024 * 1024;
 
-    if (msg.length == 0)
+    explicit PeerConnection(SOCKET sock, size_t buffer_size = default_buffer_size)
+        : sock_(sock), buffer_(buffer_size)
     {
-        msg.keepalive = true;
-        return msg;
     }
 
-    std::string rest = recv_exact(sock, msg.length);
-    msg.id = static_cast<uint8_t>(rest[0]);
-    if (msg.length > 1)
-    {
-        msg.payload = rest.substr(1);
-    }
+    PeerConnection(const PeerConnection&) = delete;
+    PeerConnection& operator=(const PeerConnection&) = delete;
 
-    return msg;
-}
+    SOCKET socket() const { return sock_; }
 
-void send_peer_message(SOCKET sock, uint8_t id, const std::string& payload)
-{
-    std::string out;
-    out.reserve(4 + 1 + payload.size());
+    /**
+     * @brief 把一条消息追加到发送队列
+     */
+    void queue_message(uint8_t id, std::string_view payload = {})
+    {
+        append_u32_be(send_buffer_, static_cast<uint32_t>(1 + payload.size()));
+        send_buffer_.push_back(static_cast<char>(id));
+        send_buffer_.append(payload);
+    }
 
-    uint32_t length = static_cast<uint32_t>(1 + payload.size());
-    append_u32_be(out, length);
-    out.push_back(static_cast<char>(id));
-    out += payload;
+    /**
+     * @brief 把一条 request 消息（id=6）直接编码进发送队列
+     */
+    void queue_request(uint32_t index, uint32_t begin, uint32_t length)
+    {
+        append_u32_be(send_buffer_, 13);
+        send_buffer_.push_back(static_cast<char>(6));
+        append_u32_be(send_buffer_, index);
+        append_u32_be(send_buffer_, begin);
+        append_u32_be(send_buffer_, length);
+    }
 
-    send_all(sock, out);
-}
+    /**
+     * @brief 追加已编码好的数据（握手、扩展消息）
+     */
+    void queue_raw(std::string_view data) { send_buffer_.append(data); }
 
-/**
- * @brief 构建 BitTorrent 握手消息
- * 
- * @param info_hash 20 字节的 info hash
- * @param peer_id 20 字节的 peer id
- * @param support_extensions 是否支持扩展协议（设置第 20 位）
- * @return std::string 68 字节的握手消息
- */
-std::string build_handshake(const std::string& info_hash, const std::string& peer_id, bool support_extensions = false)
-{
-    if (info_hash.size() != 20) throw std::runtime_error("Invalid info_hash length");
-    if (peer_id.size() != 20) throw std::runtime_error("Invalid peer_id length");
+    /**
+     * @brief 发出发送队列中的所有数据
+     */
+    void flush()
+    {
+        if (send_buffer_.empty()) return;
+        send_all(sock_, send_buffer_);
+        send_buffer_.clear();
+    }
 
-    std::string handshake;
-    handshake.reserve(68);
-    handshake.push_back(static_cast<char>(19));
-    handshake += "BitTorrent protocol";
-    
-    // 8 字节保留位
-    // 如果支持扩展，设置第 20 位（从右边数，从 0 开始）
-    // 第 20 位在第 6 个字节（索引 5）的第 4 位
-    // 00 00 00 00 00 10 00 00 (hex)
-    if (support_extensions)
+    /**
+     * @brief 最多等待 timeout，直到有数据可读；接收缓冲区里还有未消费的数据时立即返回
+     *
+     * @return 超时返回 false
+     */
+    bool wait_readable(std::chrono::milliseconds timeout)
     {
-        handshake.append(5, '\0');           // 前 5 字节为 0
-        handshake.push_back('\x10');         // 第 6 字节 = 0x10 (00010000)
-        handshake.append(2, '\0');           // 后 2 字节为 0
+        if (end_ > begin_) return true;
+        flush();
+
+        pollfd pfd{sock_, POLLIN, 0};
+        int ready = poll(&pfd, 1, static_cast<int>(timeout.count()));
+        if (ready < 0 && errno != EINTR)
+        {
+            throw std::runtime_error("Failed to wait for peer data");
+        }
+        return ready > 0;
     }
-    else
+
+    /**
+     * @brief 读取恰好 length 字节（握手等无长度前缀的数据），下一次读取前有效
+     */
+    std::string_view read_exact(size_t length)
     {
-        handshake.append(8, '\0');           // 全部为 0
+        skip_body();
+        fill(length);
+        std::string_view out(buffer_.data() + begin_, length);
+        begin_ += length;
+        return out;
     }
-    
-    handshake += info_hash;
-    handshake += peer_id;
-    return handshake;
-}
+
+    /**
+     * @brief 读取下一条消息；payload 指向接收缓冲区，下一次读取前有效
+     *
+     * id 为 streamed_id 的消息只读入 payload 的前 header_length 字节，其余 body_left() 字节
+     * 留给 read_body()；上一条消息没有读走的 body 在这里丢弃。
+     *
+     * @throws std::runtime_error 连接关闭、接收失败或消息长度超过 max_message_length
+     */
+    PeerMessage next_message(int streamed_id = -1, size_t header_length = 0)
+    {
+        skip_body();
+        fill(4);
+        PeerMessage msg;
+        msg.length = read_u32_be(std::string_view(buffer_.data() + begin_, 4), 0);
+        if (msg.length > max_message_length) throw std::runtime_error("Peer message too large");
+        if (msg.length == 0)
+        {
+            begin_ += 4;
+            msg.keepalive = true;
+            return msg;
+        }
+
+        fill(5);
+        msg.id = static_cast<uint8_t>(buffer_[begin_ + 4]);
+        size_t payload_length = msg.length - 1;
+        if (msg.id == streamed_id) payload_length = std::min(payload_length, header_length);
+
+        fill(5 + payload_length);
+        msg.payload = std::string_view(buffer_.data() + begin_ + 5, payload_length);
+        begin_ += 5 + payload_length;
+        body_left_ = msg.length - 1 - payload_length;
+        return msg;
+    }
+
+    /**
+     * @brief 当前消息尚未读取的 body 字节数
+     */
+    size_t body_left() const { return body_left_; }
+
+    /**
+     * @brief 把当前消息接下来的 length 字节 body 读入 out：先取接收缓冲区里已有的部分，
+     *        其余直接 recv 到 out，不经过接收缓冲区
+     */
+    void read_body(char* out, size_t length)
+    {
+        if (length > body_left_) throw std::runtime_error("Peer message body overrun");
+        body_left_ -= length;
+
+        size_t buffered = std::min(end_ - begin_, length);
+        std::memcpy(out, buffer_.data() + begin_, buffered);
+        begin_ += buffered;
+        for (size_t total = buffered; total < length;)
+        {
+            total += recv_some(out + total, length - total);
+        }
+    }
+
+private:
+    size_t recv_some(char* out, size_t length)
+    {
+        flush(); // 对方的回复可能依赖还在队列里的消息
+        int received = recv(sock_, out, static_cast<int>(length), 0);
+        if (received == SOCKET_ERROR)
+        {
+            throw std::runtime_error("Failed to receive data");
+        }
+        if (received == 0)
+        {
+            throw std::runtime_error("Peer closed connection");
+        }
+        return static_cast<size_t>(received);
+    }
+
+    void skip_body()
+    {
+        while (body_left_ > 0)
+        {
+            fill(1);
+            size_t n = std::min(end_ - begin_, body_left_);
+            begin_ += n;
+            body_left_ -= n;
+        }
+    }
+
+    /**
+     * @brief 保证缓冲区中至少有 length 字节未消费的数据
+     */
+    void fill(size_t length)
+    {
+        size_t buffered = end_ - begin_;
+        if (buffered >= length) return;
+        if (buffered == 0) begin_ = end_ = 0;
+
+        if (buffer_.size() - begin_ < length)
+        {
+            // 尾部放不下：未消费的部分移回开头，仍不够则扩容
+            std::memmove(buffer_.data(), buffer_.data() + begin_, buffered);
+            begin_ = 0;
+            end_ = buffered;
+            if (buffer_.size() < length) buffer_.resize(length);
+        }
+
+        while (end_ - begin_ < length)
+        {
+            end_ += recv_some(buffer_.data() + end_, buffer_.size() - end_);
+        }
+    }
+
+    SOCKET sock_;
+    std::vector<char> buffer_;
+    size_t begin_ = 0; // 第一个未消费的字节
+    size_t end_ = 0;   // 已接收数据的末尾
+    size_t body_left_ = 0;
+    std::string send_buffer_;
+};
+
+/**
+ * @brief 构建 BitTorrent 握手消息
+ * 
+ * @param info_hash 20 字节的 info hash
+ * @param peer_id 20 字节的 peer id
+ * @param support_extensions 是否支持扩展协议（设置第 20 位）
+ * @param support_v2 是否支持 BitTorrent v2（BEP 52，设置最后一个保留字节的 0x10）
+ * @return std::string 68 字节的握手消息
+ */
+std::string build_handshake(const std::string& info_hash, const std::string& peer_id, bool support_extensions = false,
+                            bool support_v2 = false)
+{
+    if (info_hash.size() != 20) throw std::runtime_error("Invalid info_hash length");
+    if (peer_id.size() != 20) throw std::runtime_error("Invalid peer_id length");
+
+    std::string handshake;
+    handshake.reserve(68);
+    handshake.push_back(static_cast<char>(19));
+    handshake += "BitTorrent protocol";
+    
+    // 8 字节保留位
+    // 如果支持扩展，设置第 20 位（从右边数，从 0 开始）
+    // 第 20 位在第 6 个字节（索引 5）的第 4 位
+    // 00 00 00 00 00 10 00 00 (hex)
+    if (support_extensions)
+    {
+        handshake.append(5, '\0');           // 前 5 字节为 0
+        handshake.push_back('\x10');         // 第 6 字节 = 0x10 (00010000)
+        handshake.append(2, '\0');           // 后 2 字节为 0
+    }
+    else
+    {
+        handshake.append(8, '\0');           // 全部为 0
+    }
+
+    // v2 支持：最后一个保留字节（索引 27）的 0x10
+    if (support_v2)
+    {
+        handshake.back() = static_cast<char>(handshake.back() | 0x10);
+    }
+    
+    handshake += info_hash;
+    handshake += peer_id;
+    return handshake;
+}
 
 /**
  * @brief 执行 BitTorrent 握手
  * 
- * @param sock 已连接的 socket
+ * @param conn 已连接的 peer
  * @param info_hash 20 字节的 info hash
  * @param my_peer_id 20 字节的本地 peer id
  * @param support_extensions 是否支持扩展协议
  * @param peer_supports_extensions 输出: 对方是否支持扩展协议
+ * @param support_v2 是否声明支持 BitTorrent v2
+ * @param peer_supports_v2 输出: 对方是否支持 BitTorrent v2（hash request 等消息）
  * @return std::string 对方的 peer id（20 字节）
  */
-std::string perform_handshake(SOCKET sock, const std::string& info_hash, const std::string& my_peer_id, 
-                              bool support_extensions = false, bool* peer_supports_extensions = nullptr)
+std::string perform_handshake(PeerConnection& conn, const std::string& info_hash, const std::string& my_peer_id, 
+                              bool support_extensions = false, bool* peer_supports_extensions = nullptr,
+                              bool support_v2 = false, bool* peer_supports_v2 = nullptr)
 {
-    std::string hs = build_handshake(info_hash, my_peer_id, support_extensions);
-    send_all(sock, hs);
+    std::string hs = build_handshake(info_hash, my_peer_id, support_extensions, support_v2);
+    conn.queue_raw(hs);
 
-    std::string response = recv_exact(sock, 68);
+    std::string_view response = conn.read_exact(68);
     if (static_cast<unsigned char>(response[0]) != 19 || response.substr(1, 19) != "BitTorrent protocol")
     {
         throw std::runtime_error("Invalid handshake response");
@@ -1199,75 +901,16 @@ std::string perform_handshake(SOCKET sock, const std::string& info_hash, const s
         unsigned char reserved_byte = static_cast<unsigned char>(response[25]);
         *peer_supports_extensions = (reserved_byte & 0x10) != 0;
     }
+    if (peer_supports_v2 != nullptr)
+    {
+        *peer_supports_v2 = (static_cast<unsigned char>(response[27]) & 0x10) != 0;
+    }
 
     // reserved(8) + info_hash(20) + peer_id(20)
-    std::string received_peer_id = response.substr(48, 20);
+    std::string received_peer_id(response.substr(48, 20));
     return received_peer_id;
 }
 
-// ============================================================================
-// Bencode 编码函数
-// ============================================================================
-
-/**
- * @brief 将 JSON 对象编码为 Bencode 格式
- */
-
-//  {"m": {"ut_metadata": 1}}
-//         ↓ bencode_encode
-// d                           ← 字典开始
-//   1:m                       ← 键 "m" (长度1)
-//   d                         ← 值是字典，字典开始
-//     11:ut_metadata          ← 键 "ut_metadata" (长度11)
-//     i1e                     ← 值 1 (整数)
-//   e                         ← 内层字典结束
-// e                           ← 外层字典结束
-
-// 最终: "d1:md11:ut_metadatai1eee"
-std::string bencode_encode(const json& j)
-{
-    if (j.is_string())
-    {
-        std::string s = j.get<std::string>();
-        return std::to_string(s.size()) + ":" + s;
-    }
-    else if (j.is_number_integer())
-    {
-        return "i" + std::to_string(j.get<int64_t>()) + "e";
-    }
-    else if (j.is_array())
-    {
-        std::string result = "l";
-        for (const auto& item : j)
-        {
-            result += bencode_encode(item);
-        }
-        result += "e";
-        return result;
-    }
-    else if (j.is_object())
-    {
-        std::string result = "d";
-        // 字典键必须按字典序排列
-        std::vector<std::string> keys;
-        for (auto it = j.begin(); it != j.end(); ++it)
-        {
-            keys.push_back(it.key());
-        }
-        std::sort(keys.begin(), keys.end());
-        
-        for (const auto& key : keys)
-        {
-            result += std::to_string(key.size()) + ":" + key;
-            result += bencode_encode(j[key]);
-        }
-        result += "e";
-        return result;
-    }
-    
-    throw std::runtime_error("Unsupported JSON type for bencode encoding");
-}
-
 // ============================================================================
 // 扩展协议相关函数
 // ============================================================================
@@ -1281,27 +924,27 @@ std::string bencode_encode(const json& j)
  * - 1 字节: 扩展消息 ID (0 = 扩展握手)
  * - N 字节: Bencode 编码的字典 {"m": {"ut_metadata": <ID>}}
  */
-void send_extension_handshake(SOCKET sock)
+void send_extension_handshake(PeerConnection& conn)
 {
     // 构建扩展握手字典
     // {"m": {"ut_metadata": 1}}
     json ext_handshake;
     ext_handshake["m"]["ut_metadata"] = 1;  // 我们使用 ID 1 表示 ut_metadata
     
-    std::string bencoded = bencode_encode(ext_handshake);
-    
-    // 构建完整消息
+    // 构建完整消息（一次分配，字典直接编码进消息缓冲区）
+    size_t bencoded_size = bencode_encoded_size(ext_handshake);
     std::string message;
+    message.reserve(4 + 2 + bencoded_size);
     
-    // 消息长度 = 1 (消息ID) + 1 (扩展消息ID) + bencoded.size()
-    uint32_t length = static_cast<uint32_t>(2 + bencoded.size());
+    // 消息长度 = 1 (消息ID) + 1 (扩展消息ID) + bencoded_size
+    uint32_t length = static_cast<uint32_t>(2 + bencoded_size);
     append_u32_be(message, length);
     
     message.push_back(static_cast<char>(20));  // 消息 ID = 20 (扩展消息)
     message.push_back(static_cast<char>(0));   // 扩展消息 ID = 0 (扩展握手)
-    message += bencoded;
+    bencode_append(message, ext_handshake);
     
-    send_all(sock, message);
+    conn.queue_raw(message);
 }
 
 /**
@@ -1313,15 +956,16 @@ void send_extension_handshake(SOCKET sock)
  * - 1 字节: 扩展消息 ID (0 = 扩展握手)
  * - N 字节: Bencode 编码的字典 {"m": {"ut_metadata": <ID>}, ...}
  * 
- * @param sock 已连接的 socket
- * @return json 解析后的扩展握手字典
+ * @param conn 已连接的 peer
+ * @param arena 解析结果所在的 arena
+ * @return 解析后的扩展握手字典（随 arena 释放）
  */
-json recv_extension_handshake(SOCKET sock)
+const BencodeValue& recv_extension_handshake(PeerConnection& conn, BencodeArena& arena)
 {
     // 循环接收消息，直到收到扩展握手消息 (ID=20, ExtID=0)
     while (true)
     {
-        PeerMessage msg = recv_peer_message(sock);
+        PeerMessage msg = conn.next_message();
         
         if (msg.keepalive) continue;
         
@@ -1334,9 +978,8 @@ json recv_extension_handshake(SOCKET sock)
             // 扩展握手的扩展消息 ID 是 0
             if (ext_msg_id == 0)
             {
-                // 剩余部分是 Bencode 编码的字典
-                std::string bencoded = msg.payload.substr(1);
-                return decode_bencoded_value(bencoded);
+                // 剩余部分是 Bencode 编码的字典（直接在 payload 上解析进 arena）
+                return BencodeValue::parse(msg.payload.substr(1), arena);
             }
         }
         
@@ -1355,33 +998,55 @@ json recv_extension_handshake(SOCKET sock)
  *           msg_type=0 表示请求消息
  *           piece=0 表示请求第 0 个元数据分片
  * 
- * @param sock 已连接的 socket
+ * @param conn 已连接的 peer
  * @param peer_metadata_id 对方的 ut_metadata 扩展 ID
  * @param piece_index 要请求的元数据分片索引（通常为 0）
  */
-void send_metadata_request(SOCKET sock, int peer_metadata_id, int piece_index = 0)
+void send_metadata_request(PeerConnection& conn, int peer_metadata_id, int piece_index = 0)
 {
     // 构建请求字典 {"msg_type": 0, "piece": 0}
     json request;
     request["msg_type"] = 0;  // 0 = request
     request["piece"] = piece_index;
     
-    std::string bencoded = bencode_encode(request);
-    
-    // 构建完整消息
+    // 构建完整消息（一次分配，字典直接编码进消息缓冲区）
+    size_t bencoded_size = bencode_encoded_size(request);
     std::string message;
+    message.reserve(4 + 2 + bencoded_size);
     
-    // 消息长度 = 1 (消息ID) + 1 (扩展消息ID) + bencoded.size()
-    uint32_t length = static_cast<uint32_t>(2 + bencoded.size());
+    // 消息长度 = 1 (消息ID) + 1 (扩展消息ID) + bencoded_size
+    uint32_t length = static_cast<uint32_t>(2 + bencoded_size);
     append_u32_be(message, length);
     
     message.push_back(static_cast<char>(20));  // 消息 ID = 20 (扩展消息)
     message.push_back(static_cast<char>(peer_metadata_id));  // 对方的 ut_metadata ID
-    message += bencoded;
+    bencode_append(message, request);
     
-    send_all(sock, message);
+    conn.queue_raw(message);
 }
 
+/**
+ * @brief ut_metadata 消息头部字典的 SAX 回调：只取顶层的 msg_type
+ */
+class MetadataMessageHandler : public BencodeHandler
+{
+public:
+    int64_t msg_type = -1;
+
+    void on_dict_begin() override { depth_++; }
+    void on_list_begin() override { depth_++; }
+    void on_end() override { depth_--; }
+    void on_key(std::string_view key) override { key_.assign(key); }
+    void on_int(int64_t value) override
+    {
+        if (depth_ == 1 && key_ == "msg_type") msg_type = value;
+    }
+
+private:
+    int depth_ = 0;
+    std::string key_;
+};
+
 /**
  * @brief 接收元数据数据消息
  * 
@@ -1392,46 +1057,31 @@ void send_metadata_request(SOCKET sock, int peer_metadata_id, int piece_index =
  * - N 字节: Bencode 编码的字典 {'msg_type': 1, 'piece': 0, 'total_size': XXXX}
  * - M 字节: metadata piece contents (实际的 info 字典数据)
  * 
- * @param sock 已连接的 socket
+ * @param conn 已连接的 peer
  * @return std::string metadata 内容（info 字典的 bencode 编码）
  */
-std::string recv_metadata_data(SOCKET sock)
+std::string recv_metadata_data(PeerConnection& conn)
 {
     // 循环接收消息，直到收到 metadata data 消息 (ID=20, msg_type=1)
+    // 头部字典直接在接收缓冲区里的 payload 上解析，之后的 metadata 内容只拷贝一次到结果中
     while (true)
     {
-        PeerMessage msg = recv_peer_message(sock);
-        
+        PeerMessage msg = conn.next_message();
         if (msg.keepalive) continue;
-        
-        // 检查是否是扩展消息 (ID=20)
-        if (msg.id == 20 && !msg.payload.empty())
-        {
-            // 第一个字节是扩展消息 ID（应该是我们告诉对方的 ut_metadata ID = 1）
-            uint8_t ext_msg_id = static_cast<uint8_t>(msg.payload[0]);
-            
-            // 我们在扩展握手中告诉对方我们的 ut_metadata ID 是 1
-            if (ext_msg_id == 1)
-            {
-                // 剩余部分: bencode 字典 + metadata 内容
-                std::string rest = msg.payload.substr(1);
-                
-                // 解析 bencode 字典，获取其结束位置
-                size_t pos = 0;
-                json dict = decode_bencoded_value(rest, pos);
-                
-                // 检查 msg_type 是否为 1 (data)
-                if (dict.contains("msg_type") && dict["msg_type"].get<int>() == 1)
-                {
-                    // pos 现在指向 bencode 字典结束后的位置
-                    // 剩余部分就是 metadata piece contents
-                    std::string metadata = rest.substr(pos);
-                    return metadata;
-                }
-            }
-        }
-        
-        // 其他消息类型，继续等待
+
+        // 检查是否是扩展消息 (ID=20)，且扩展消息 ID 是我们在扩展握手中
+        // 告诉对方的 ut_metadata ID = 1
+        if (msg.id != 20 || msg.payload.empty() || msg.payload[0] != 1) continue;
+
+        // 剩余部分: bencode 字典 + metadata 内容
+        std::string_view body = msg.payload.substr(1);
+        MetadataMessageHandler handler;
+        BencodeStreamParser parser(handler);
+        body.remove_prefix(parser.feed(body));
+        if (!parser.done()) throw std::runtime_error("Truncated ut_metadata message");
+
+        // 检查 msg_type 是否为 1 (data)
+        if (handler.msg_type == 1) return std::string(body);
     }
 }
 
@@ -1450,26 +1100,26 @@ bool bitfield_has_piece(const std::string& bitfield, int piece_index)
     return ((b >> bit_in_byte) & 1u) != 0;
 }
 
-std::string recv_bitfield_payload(SOCKET sock)
+std::string recv_bitfield_payload(PeerConnection& conn)
 {
     while (true)
     {
-        PeerMessage msg = recv_peer_message(sock);
+        PeerMessage msg = conn.next_message();
         if (msg.keepalive) continue;
         if (msg.id == 5)
         {
-            return msg.payload;
+            return std::string(msg.payload);
         }
         // 其他消息忽略（比如 have/unchoke/choke）
     }
 }
 
-bool wait_for_unchoke(SOCKET sock)
+bool wait_for_unchoke(PeerConnection& conn)
 {
     bool choked = true;
     while (choked)
     {
-        PeerMessage msg = recv_peer_message(sock);
+        PeerMessage msg = conn.next_message();
         if (msg.keepalive) continue;
         if (msg.id == 1) choked = false;      // unchoke
         else if (msg.id == 0) choked = true;  // choke
@@ -1478,274 +1128,1677 @@ bool wait_for_unchoke(SOCKET sock)
     return true;
 }
 
-std::string download_piece_from_peer(SOCKET sock, int piece_index, int64_t piece_size)
+/**
+ * @brief piece 的增量 SHA-1
+ *
+ * block 一落入 piece 缓冲区就调用 on_block()：如果它与已哈希的前缀相连，
+ * 立即喂给 SHA1，并顺带把之前乱序到达、现已连续的 block 一并喂入；
+ * 否则只在重排窗口里记一笔（数据已在缓冲区中，不额外拷贝）。
+ * 最后一个 block 到达时摘要随即可用，省去整 piece 的事后哈希。
+ */
+struct PieceHasher
 {
-    const int64_t block_size = 16 * 1024;
+    static constexpr int64_t block_size = 16 * 1024;
 
-    std::string piece_data;
-    piece_data.resize(static_cast<size_t>(piece_size));
+    PieceHasher(const std::string& piece_data, int64_t piece_size)
+        : data(piece_data),
+          size(piece_size),
+          received(static_cast<size_t>((piece_size + block_size - 1) / block_size), 0)
+    {
+    }
 
-    for (int64_t begin = 0; begin < piece_size; begin += block_size)
+    void on_block(int64_t begin)
     {
-        int64_t req_len = std::min(block_size, piece_size - begin);
+        size_t idx = static_cast<size_t>(begin / block_size);
+        if (idx >= received.size() || received[idx]) return;
+        received[idx] = 1;
 
-        bool done = false;
-        while (!done)
+        // 从已哈希前缀开始，把所有连续到达的 block 依次喂入
+        while (next_block < received.size() && received[next_block])
         {
-            // request payload: index(4) + begin(4) + length(4)
-            std::string payload;
-            payload.reserve(12);
-            append_u32_be(payload, static_cast<uint32_t>(piece_index));
-            append_u32_be(payload, static_cast<uint32_t>(begin));
-            append_u32_be(payload, static_cast<uint32_t>(req_len));
-            send_peer_message(sock, 6, payload);
-
-            bool choked = false;
-            while (true)
-            {
-                PeerMessage msg = recv_peer_message(sock);
-                if (msg.keepalive) continue;
-
-                if (msg.id == 0)
-                {
-                    choked = true;
-                    break;
-                }
-                if (msg.id == 1)
-                {
-                    // unchoke
-                    continue;
-                }
-
-                if (msg.id != 7) continue;
+            int64_t offset = static_cast<int64_t>(next_block) * block_size;
+            int64_t len = std::min(block_size, size - offset);
+            sha1.update(reinterpret_cast<const uint8_t*>(data.data()) + offset, static_cast<size_t>(len));
+            next_block++;
+        }
+    }
 
-                if (msg.payload.size() < 8)
-                {
-                    throw std::runtime_error("Invalid piece message payload");
-                }
+    bool complete() const { return next_block == received.size(); }
 
-                uint32_t resp_index = read_u32_be(msg.payload, 0);
-                uint32_t resp_begin = read_u32_be(msg.payload, 4);
-                if (resp_index != static_cast<uint32_t>(piece_index) || resp_begin != static_cast<uint32_t>(begin))
-                {
-                    // 乱序/其他 piece 的数据，继续等
-                    continue;
-                }
+    std::string digest()
+    {
+        if (!complete()) throw std::runtime_error("Piece not fully hashed");
+        return sha1.final();
+    }
 
-                std::string block = msg.payload.substr(8);
-                if (static_cast<int64_t>(block.size()) != req_len)
-                {
-                    throw std::runtime_error("Unexpected block length");
-                }
+    const std::string& data;
+    int64_t size;
+    std::vector<uint8_t> received; // 重排窗口：每个 block 是否已到达
+    size_t next_block = 0;         // 已喂入 SHA1 的 block 数（连续前缀）
+    SHA1 sha1;
+};
 
-                std::memcpy(&piece_data[static_cast<size_t>(begin)], block.data(), block.size());
-                done = true;
-                break;
-            }
+// ============================================================================
+// BitTorrent v2（BEP 52）：file tree / piece layers / 逐 block merkle 校验
+// ============================================================================
+//
+// v2 info 字典没有 pieces，而是 "file tree"：
+//   { "dir": { "a.txt": { "": { "length": N, "pieces root": <32B> } } } }
+// 顶层（info 之外）的 "piece layers" 以 pieces root 为键，值为该文件 piece 层的
+// 32 字节哈希拼接；不超过一个 piece 的文件不出现在 piece layers 中。
+//
+// 下载时先用 hash request（id=21）向 peer 要本 piece 覆盖的叶子（16 KiB block）哈希，
+// 验证它们的子树根等于 piece layers 中的值后，每收到一个 block 就单独比较，
+// 坏 block 只重新请求它自己，而不是整 piece 丢弃（V2PieceLayer / PieceMerkleVerifier，
+// 见 piece_merkle.hpp）。逐 block 校验只支持单文件的 v2/hybrid torrent；多文件 hybrid torrent
+// 按 v1 的 SHA-1 pieces 校验，多文件纯 v2 torrent 不支持。
 
-            if (choked)
-            {
-                // 被 choke 了，等再次 unchoke 后重发本 block 的 request
-                wait_for_unchoke(sock);
-            }
-        }
+/**
+ * @brief 计算 handshake / tracker 使用的 20 字节 info hash
+ *
+ * 直接对 info 字典的原始字节（解析时记录的 raw 区间）计算：
+ * v1 与 hybrid torrent 用 SHA-1；纯 v2 torrent 用 SHA-256 截断到 20 字节。
+ */
+std::string torrent_info_hash(const InfoDict& info)
+{
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(info.raw.data());
+    if (info.has_pieces)
+    {
+        SHA1 sha1;
+        sha1.update(data, info.raw.size());
+        return sha1.final();
     }
-
-    return piece_data;
+    return SHA256::hash(data, info.raw.size()).substr(0, 20);
 }
 
+
 // ============================================================================
-// 并发下载 work queue（download 命令用）
+// request 流水线（多个 block request 同时在途，可跨 piece 边界）
 // ============================================================================
+//
+// 一问一答式地请求 block，每个 peer 的吞吐被限制在每个 RTT 一个 16 KiB block。
+// PeerPipeline 让最多 depth 个 request 同时在途：当前 piece 的 block 都已发出请求时，
+// 提前领取下一个 piece 接着请求；piece 消息按 (index, begin) 与在途 request 匹配，
+// 到达顺序任意。被 choke 时 peer 会丢弃所有未回复的 request，这些 block 在 unchoke 后重新请求。
+// depth 随每个连接测得的带宽与 RTT 调整（PipelineDepthEstimator），不超过对方声明的 reqq。
 
-struct PieceWorkQueue
+/**
+ * @brief 正在从 peer 下载的一个 piece
+ */
+struct PipelinePiece
 {
-    std::mutex mu;
-    std::vector<uint8_t> state; // 0=pending,1=in_progress,2=done
-    std::atomic<int64_t> remaining{0};
+    PipelinePiece(int piece_index, int64_t piece_size)
+        : index(piece_index),
+          size(piece_size),
+          data(static_cast<size_t>(piece_size), '\0'),
+          block_count(static_cast<size_t>((piece_size + PieceHasher::block_size - 1) / PieceHasher::block_size)),
+          blocks_left(block_count)
+    {
+    }
 
-    explicit PieceWorkQueue(int64_t num_pieces)
-        : state(static_cast<size_t>(num_pieces), 0), remaining(num_pieces)
+    int64_t block_length(size_t block) const
     {
+        int64_t begin = static_cast<int64_t>(block) * PieceHasher::block_size;
+        return std::min(PieceHasher::block_size, size - begin);
     }
+
+    int index;
+    int64_t size;
+    std::string data;
+    size_t block_count;
+    size_t blocks_left;                   // 尚未收到（或校验失败待重收）的 block 数
+    size_t next_block = 0;                // 下一个从未请求过的 block
+    std::vector<size_t> retry;            // 需要重新请求的 block（被 choke 丢弃或校验失败）
+    int bad_blocks = 0;                   // merkle 校验失败的 block 数
+    std::unique_ptr<PieceHasher> hasher;  // 非空时边收边算 SHA-1
+    std::unique_ptr<PieceMerkleVerifier> merkle;
+    PipelineDepthEstimator::clock::time_point hash_deadline; // hash request 的回复期限
 };
 
-int acquire_next_piece(PieceWorkQueue& q, const std::string& bitfield, int64_t num_pieces)
+class PeerPipeline
 {
-    std::lock_guard<std::mutex> lock(q.mu);
-    if (q.remaining.load() <= 0) return -1;
+public:
+    /**
+     * @param depth 初始的在途 request 数，之后按测得的带宽与 RTT 调整
+     * @param hash_pieces 为每个 piece 增量计算 SHA-1（PipelinePiece::hasher）
+     * @param v2 非空时（v2 torrent）每个 block 到达即做 SHA-256 merkle 校验，坏 block 单独重新请求；
+     *           无法取得叶子哈希时整 piece 校验，失败则整 piece 重新下载
+     */
+    PeerPipeline(PeerConnection& conn, size_t depth, bool hash_pieces = false, const V2PieceLayer* v2 = nullptr,
+                 bool peer_supports_v2 = false)
+        : conn_(conn), depth_(depth), hash_pieces_(hash_pieces), v2_(v2), peer_supports_v2_(peer_supports_v2)
+    {
+    }
 
-    for (int64_t i = 0; i < num_pieces; i++)
+    PeerPipeline(const PeerPipeline&) = delete;
+    PeerPipeline& operator=(const PeerPipeline&) = delete;
+
+    /**
+     * @brief 加入一个要下载的 piece；v2 torrent 同时发出它的 hash request
+     */
+    void add_piece(int piece_index, int64_t piece_size)
     {
-        if (q.state[static_cast<size_t>(i)] != 0) continue;
-        if (!bitfield.empty() && !bitfield_has_piece(bitfield, static_cast<int>(i))) continue;
+        auto piece = std::make_unique<PipelinePiece>(piece_index, piece_size);
+        if (hash_pieces_) piece->hasher = std::make_unique<PieceHasher>(piece->data, piece_size);
+        if (v2_ != nullptr)
+        {
+            piece->merkle = std::make_unique<PieceMerkleVerifier>(*v2_, piece_index, piece_size, peer_supports_v2_);
+            for (const std::string& request : piece->merkle->leaf_hash_requests()) conn_.queue_message(21, request);
+            piece->hash_deadline = PipelineDepthEstimator::clock::now() + hash_request_timeout;
+        }
+        unrequested_ += piece->block_count;
+        active_.push_back(std::move(piece));
+    }
 
-        q.state[static_cast<size_t>(i)] = 1;
-        return static_cast<int>(i);
+    /**
+     * @brief 已领取但尚未请求的 block 不足以填满流水线，应再领取一个 piece
+     */
+    bool wants_piece() const { return unrequested_ < depth_.target(); }
+
+    bool idle() const { return active_.empty() && completed_.empty(); }
+
+    /**
+     * @brief 收发消息直到有 piece 下载完成（按完成顺序返回）
+     *
+     * @param more_pieces 调用方还能领取新 piece：此时流水线一旦需要新 piece（wants_piece()）
+     *                    就返回 nullptr，让调用方先领取，request 才能不间断地跨 piece 边界
+     */
+    std::unique_ptr<PipelinePiece> next_completed(bool more_pieces = false)
+    {
+        while (completed_.empty())
+        {
+            if (active_.empty()) throw std::runtime_error("No piece in pipeline");
+            if (more_pieces && wants_piece()) return nullptr;
+            if (!choked_) send_requests();
+            if (!wait_for_message()) continue;
+
+            PeerMessage msg = conn_.next_message(7, 8);
+            if (msg.keepalive) continue;
+
+            if (msg.id == 0) on_choke();
+            else if (msg.id == 1) choked_ = false;
+            else if (msg.id == 7) on_block(msg.payload);
+            else if (msg.id == 20) on_extended(msg.payload);
+            else if (msg.id == 22 || msg.id == 23) on_hashes(msg);
+            // 其他消息忽略
+        }
+
+        std::unique_ptr<PipelinePiece> piece = std::move(completed_.front());
+        completed_.pop_front();
+        return piece;
     }
 
-    return -1;
-}
+    /**
+     * @brief 已领取、尚未返回给调用方的 piece（连接出错时交还给 work queue）
+     */
+    std::vector<int> pending_pieces() const
+    {
+        std::vector<int> out;
+        for (const auto& p : active_) out.push_back(p->index);
+        for (const auto& p : completed_) out.push_back(p->index);
+        return out;
+    }
+
+private:
+    static constexpr int max_block_attempts = 5;
+    static constexpr std::chrono::seconds hash_request_timeout{10};
+
+    struct BlockRequest
+    {
+        PipelinePiece* piece;
+        size_t block;
+        uint32_t begin;
+        uint32_t length;
+        PipelineDepthEstimator::clock::time_point sent;
+    };
+
+    /**
+     * @brief 补发 request 直到在途数达到 depth：先重发待重试的 block，再按顺序请求新 block
+     */
+    void send_requests()
+    {
+        const size_t depth = depth_.target();
+        for (auto& p : active_)
+        {
+            PipelinePiece& piece = *p;
+            while (outstanding_.size() < depth && (!piece.retry.empty() || piece.next_block < piece.block_count))
+            {
+                size_t block;
+                if (!piece.retry.empty())
+                {
+                    block = piece.retry.back();
+                    piece.retry.pop_back();
+                }
+                else
+                {
+                    block = piece.next_block++;
+                    unrequested_--;
+                }
+
+                BlockRequest req{&piece, block, static_cast<uint32_t>(static_cast<int64_t>(block) * PieceHasher::block_size),
+                                 static_cast<uint32_t>(piece.block_length(block)), PipelineDepthEstimator::clock::now()};
+
+                // 只进发送队列，下一次接收前与本轮其余 request 一起发出
+                conn_.queue_request(static_cast<uint32_t>(piece.index), req.begin, req.length);
+                outstanding_.push_back(req);
+            }
+            if (outstanding_.size() >= depth) return;
+        }
+    }
+
+    /**
+     * @brief 被 choke：peer 丢弃了所有未回复的 request，unchoke 后全部重新请求
+     */
+    void on_choke()
+    {
+        choked_ = true;
+        for (const BlockRequest& req : outstanding_) req.piece->retry.push_back(req.block);
+        outstanding_.clear();
+    }
+
+    /**
+     * @param header piece 消息的 index/begin；block 数据仍在连接里，直接收进 piece 缓冲区
+     */
+    void on_block(std::string_view header)
+    {
+        if (header.size() < 8)
+        {
+            throw std::runtime_error("Invalid piece message payload");
+        }
+
+        uint32_t index = read_u32_be(header, 0);
+        uint32_t begin = read_u32_be(header, 4);
+        auto it = std::find_if(outstanding_.begin(), outstanding_.end(), [&](const BlockRequest& req) {
+            return static_cast<uint32_t>(req.piece->index) == index && req.begin == begin;
+        });
+        if (it == outstanding_.end())
+        {
+            // 没有请求过（或 choke 后已作废）的数据，忽略（读下一条消息时丢弃）
+            return;
+        }
+
+        BlockRequest req = *it;
+        outstanding_.erase(it);
+        PipelinePiece& piece = *req.piece;
+
+        if (conn_.body_left() != req.length)
+        {
+            throw std::runtime_error("Unexpected block length");
+        }
+
+        char* block = &piece.data[req.begin];
+        conn_.read_body(block, req.length);
+        auto now = PipelineDepthEstimator::clock::now();
+        depth_.on_block(now, now - req.sent, req.length);
+
+        if (piece.merkle && !piece.merkle->verify_block(req.begin, block, req.length))
+        {
+            // 坏 block：只重新请求这一个（位置上的数据之后会被覆盖）
+            reject_block(piece, req.block);
+            return;
+        }
+
+        if (piece.hasher) piece.hasher->on_block(req.begin);
+        piece.blocks_left--;
+        if (piece.blocks_left == 0) finish_piece(piece);
+    }
+
+    /**
+     * @brief 对方的扩展握手：只取 reqq；格式错误的握手忽略，保持当前限制
+     */
+    void on_extended(std::string_view payload)
+    {
+        if (payload.empty() || payload[0] != 0) return;
+
+        BencodeArena arena;
+        const BencodeValue* reqq = nullptr;
+        try
+        {
+            const BencodeValue& handshake = BencodeValue::parse(payload.substr(1), arena);
+            if (handshake.is_dict()) reqq = handshake.find("reqq");
+        }
+        catch (const std::runtime_error&)
+        {
+            return;
+        }
+        if (reqq != nullptr && reqq->is_int() && reqq->as_int() > 0)
+        {
+            depth_.set_limit(static_cast<size_t>(std::min<int64_t>(reqq->as_int(), max_pipeline_depth)));
+        }
+    }
+
+    void on_hashes(const PeerMessage& msg)
+    {
+        for (auto& p : active_)
+        {
+            PipelinePiece& piece = *p;
+            std::vector<size_t> bad;
+            if (!piece.merkle || !piece.merkle->on_hashes(msg.id, msg.payload, bad)) continue;
+
+            // 叶子哈希到达前已收下的 block 中有坏的：重新请求
+            for (size_t block : bad)
+            {
+                piece.blocks_left++;
+                reject_block(piece, block);
+            }
+            if (piece.blocks_left == 0) finish_piece(piece);
+            return;
+        }
+    }
+
+    /**
+     * @brief 有 hash request 未回复时，最多等到最早的回复期限
+     *
+     * @return 超时返回 false：到期的 hash request 被放弃，对应 piece 改为整 piece 校验
+     */
+    bool wait_for_message()
+    {
+        using clock = PipelineDepthEstimator::clock;
+        auto deadline = clock::time_point::max();
+        for (const auto& p : active_)
+        {
+            if (p->merkle && p->merkle->hashes_pending()) deadline = std::min(deadline, p->hash_deadline);
+        }
+        if (deadline == clock::time_point::max()) return true;
+
+        auto now = clock::now();
+        if (now < deadline &&
+            conn_.wait_readable(std::chrono::ceil<std::chrono::milliseconds>(deadline - now)))
+        {
+            return true;
+        }
+
+        // 对方不回复 hash request：不再等待，已收齐的 piece 立即做整 piece 校验
+        std::vector<PipelinePiece*> expired;
+        now = clock::now();
+        for (const auto& p : active_)
+        {
+            if (p->merkle && p->merkle->hashes_pending() && p->hash_deadline <= now) expired.push_back(p.get());
+        }
+        for (PipelinePiece* piece : expired)
+        {
+            piece->merkle->abandon_hash_requests();
+            if (piece->blocks_left == 0) finish_piece(*piece);
+        }
+        return false;
+    }
+
+    void reject_block(PipelinePiece& piece, size_t block)
+    {
+        if (++piece.bad_blocks >= max_block_attempts)
+        {
+            throw std::runtime_error("Block failed merkle verification");
+        }
+        piece.retry.push_back(block);
+    }
+
+    /**
+     * @brief 所有 block 都已收到：等叶子哈希回复后做整 piece 校验，通过则移入 completed_
+     */
+    void finish_piece(PipelinePiece& piece)
+    {
+        if (piece.merkle)
+        {
+            if (piece.merkle->hashes_pending()) return; // hashes 回复到达（或超时放弃）时再结束
+
+            if (!piece.merkle->verify_piece())
+            {
+                // 没有叶子哈希就无法定位坏 block，只能整 piece 重新下载
+                if (++piece.merkle->piece_attempts >= max_block_attempts)
+                {
+                    throw std::runtime_error("Piece merkle root mismatch");
+                }
+                piece.retry.clear();
+                piece.next_block = 0;
+                piece.blocks_left = piece.block_count;
+                unrequested_ += piece.block_count;
+                return;
+            }
+        }
+
+        auto it = std::find_if(active_.begin(), active_.end(), [&](const auto& p) { return p.get() == &piece; });
+        completed_.push_back(std::move(*it));
+        active_.erase(it);
+    }
+
+    PeerConnection& conn_;
+    PipelineDepthEstimator depth_;
+    const bool hash_pieces_;
+    const V2PieceLayer* v2_;
+    const bool peer_supports_v2_;
+    bool choked_ = false;
+    size_t unrequested_ = 0;                               // 已领取 piece 中从未请求过的 block 数
+    std::vector<std::unique_ptr<PipelinePiece>> active_;   // 按领取顺序，先领的先请求
+    std::deque<std::unique_ptr<PipelinePiece>> completed_;
+    std::vector<BlockRequest> outstanding_;                // 在途 request
+};
+
+/**
+ * @brief 从 peer 下载一个 piece（download_piece 命令用；request 同样流水线化）
+ *
+ * @param piece_hash 非空时在接收过程中增量计算 SHA-1，下载完成时写入 20 字节摘要
+ * @param v2 非空时（v2 torrent）逐 block 做 SHA-256 merkle 校验
+ */
+std::string download_piece_from_peer(PeerConnection& conn, int piece_index, int64_t piece_size, std::string* piece_hash = nullptr,
+                                     const V2PieceLayer* v2 = nullptr, bool peer_supports_v2 = false,
+                                     size_t pipeline_depth = default_pipeline_depth)
+{
+    PeerPipeline pipeline(conn, pipeline_depth, piece_hash != nullptr, v2, peer_supports_v2);
+    pipeline.add_piece(piece_index, piece_size);
+    std::unique_ptr<PipelinePiece> piece = pipeline.next_completed();
+
+    if (piece_hash != nullptr)
+    {
+        *piece_hash = piece->hasher->digest();
+    }
+    return std::move(piece->data);
+}
+
+// ============================================================================
+// piece 哈希表
+// ============================================================================
+
+/**
+ * @brief torrent 的 piece SHA-1 表：连续存放的 20 字节摘要
+ *
+ * 从 pieces 字段解析一次，之后所有 worker / 校验线程以 const 引用共享；
+ * 比较时直接与表中摘要 memcmp，不产生任何临时字符串。
+ */
+class PieceHashTable
+{
+public:
+    using Digest = std::array<uint8_t, 20>;
+    static_assert(sizeof(Digest) == 20, "Digest must be tightly packed");
+
+    PieceHashTable() = default;
+
+    explicit PieceHashTable(std::string_view pieces_blob)
+    {
+        if (pieces_blob.size() % 20 != 0)
+        {
+            throw std::runtime_error("Invalid pieces field length");
+        }
+        hashes_.resize(pieces_blob.size() / 20);
+        if (!hashes_.empty())
+        {
+            std::memcpy(hashes_.data(), pieces_blob.data(), pieces_blob.size());
+        }
+    }
+
+    size_t size() const { return hashes_.size(); }
+    bool empty() const { return hashes_.empty(); }
+
+    /**
+     * @brief 第 index 个 piece 的摘要是否等于 digest（越界视为不匹配）
+     */
+    bool matches(size_t index, const uint8_t* digest) const
+    {
+        return index < hashes_.size() && std::memcmp(hashes_[index].data(), digest, 20) == 0;
+    }
+
+private:
+    std::vector<Digest> hashes_;
+};
+
+// ============================================================================
+// 并发下载 work queue（download 命令用）
+// ============================================================================
+
+struct PieceWorkQueue
+{
+    std::mutex mu;
+    std::condition_variable cv;   // piece 状态变化（校验结束）时通知等待的 worker
+    std::vector<uint8_t> state;   // 0=pending,1=in_progress,2=done,3=verifying
+    std::atomic<int64_t> remaining{0};
+    int64_t verifying = 0;        // 已交给校验线程、尚无结果的 piece 数
+
+    explicit PieceWorkQueue(int64_t num_pieces)
+        : state(static_cast<size_t>(num_pieces), 0), remaining(num_pieces)
+    {
+    }
+};
+
+int acquire_next_piece_locked(PieceWorkQueue& q, const std::string& bitfield, int64_t num_pieces)
+{
+    if (q.remaining.load() <= 0) return -1;
+
+    for (int64_t i = 0; i < num_pieces; i++)
+    {
+        if (q.state[static_cast<size_t>(i)] != 0) continue;
+        if (!bitfield.empty() && !bitfield_has_piece(bitfield, static_cast<int>(i))) continue;
+
+        q.state[static_cast<size_t>(i)] = 1;
+        return static_cast<int>(i);
+    }
+
+    return -1;
+}
+
+int acquire_next_piece(PieceWorkQueue& q, const std::string& bitfield, int64_t num_pieces)
+{
+    std::lock_guard<std::mutex> lock(q.mu);
+    return acquire_next_piece_locked(q, bitfield, num_pieces);
+}
+
+/**
+ * @brief 领取下一个 piece；暂时没有可领的但仍有 piece 在校验中时等待结果
+ *
+ * 校验失败的 piece 会回到 pending，所以 worker 不能在校验结束前退出，
+ * 否则最后几个校验失败的 piece 可能没人重新下载。
+ */
+int wait_next_piece(PieceWorkQueue& q, const std::string& bitfield, int64_t num_pieces)
+{
+    std::unique_lock<std::mutex> lock(q.mu);
+    while (true)
+    {
+        int piece = acquire_next_piece_locked(q, bitfield, num_pieces);
+        if (piece >= 0) return piece;
+        if (q.verifying == 0 || q.remaining.load() <= 0) return -1;
+        q.cv.wait(lock);
+    }
+}
+
+void mark_piece_verifying(PieceWorkQueue& q, int piece_index)
+{
+    std::lock_guard<std::mutex> lock(q.mu);
+    if (piece_index < 0) return;
+    size_t idx = static_cast<size_t>(piece_index);
+    if (idx >= q.state.size()) return;
+
+    if (q.state[idx] == 1)
+    {
+        q.state[idx] = 3;
+        q.verifying++;
+    }
+}
+
+void mark_piece_done(PieceWorkQueue& q, int piece_index)
+{
+    {
+        std::lock_guard<std::mutex> lock(q.mu);
+        if (piece_index < 0) return;
+        size_t idx = static_cast<size_t>(piece_index);
+        if (idx >= q.state.size()) return;
+
+        if (q.state[idx] == 1 || q.state[idx] == 3)
+        {
+            if (q.state[idx] == 3) q.verifying--;
+            q.state[idx] = 2;
+            q.remaining.fetch_sub(1);
+        }
+    }
+    q.cv.notify_all();
+}
+
+void mark_piece_retry(PieceWorkQueue& q, int piece_index)
+{
+    {
+        std::lock_guard<std::mutex> lock(q.mu);
+        if (piece_index < 0) return;
+        size_t idx = static_cast<size_t>(piece_index);
+        if (idx >= q.state.size()) return;
+
+        if (q.state[idx] == 1 || q.state[idx] == 3)
+        {
+            if (q.state[idx] == 3) q.verifying--;
+            q.state[idx] = 0;
+        }
+    }
+    q.cv.notify_all();
+}
+
+// ============================================================================
+// piece 校验线程池（download 命令用）
+// ============================================================================
+//
+// 网络线程收完一个 piece 后把它放进有界队列，立刻回去请求下一个 piece。
+// piece 的 SHA-1 已在接收时随 block 到达增量算好（VerifyJob::digest，数据还在缓存里），
+// 校验线程只与 torrent 中的哈希比较，通过的写入整文件缓冲区并 mark_piece_done，
+// 失败的 mark_piece_retry。
+// 队列满时 submit 阻塞，对网络线程形成背压，限制内存中待校验的 piece 数。
+// v2 torrent 的 piece 在接收时已逐 block 做过 merkle 校验（verified=true），这里只写缓冲区。
+
+struct VerifyJob
+{
+    int piece_index = -1;
+    int64_t piece_offset = 0;
+    std::string data;
+    std::string digest;    // 接收时增量算好的 20 字节 SHA-1（v1）
+    bool verified = false; // 已通过 v2 merkle 校验，无需再做 SHA-1
+};
+
+class PieceVerifier
+{
+public:
+    PieceVerifier(PieceWorkQueue& queue, const PieceHashTable& hashes, std::vector<char>& out_buf,
+                  size_t num_threads, size_t capacity)
+        : queue_(queue), hashes_(hashes), out_buf_(out_buf), capacity_(std::max<size_t>(1, capacity))
+    {
+        num_threads = std::max<size_t>(1, num_threads);
+        threads_.reserve(num_threads);
+        for (size_t i = 0; i < num_threads; i++)
+        {
+            threads_.emplace_back([this]() { run(); });
+        }
+    }
+
+    ~PieceVerifier()
+    {
+        close();
+    }
+
+    PieceVerifier(const PieceVerifier&) = delete;
+    PieceVerifier& operator=(const PieceVerifier&) = delete;
+
+    /**
+     * @brief 提交一个已下载完的 piece（队列满时阻塞）
+     */
+    void submit(VerifyJob job)
+    {
+        mark_piece_verifying(queue_, job.piece_index);
+
+        std::unique_lock<std::mutex> lock(mu_);
+        not_full_.wait(lock, [this]() { return jobs_.size() < capacity_ || closed_; });
+        if (closed_)
+        {
+            lock.unlock();
+            mark_piece_retry(queue_, job.piece_index);
+            return;
+        }
+        jobs_.push_back(std::move(job));
+        not_empty_.notify_one();
+    }
+
+    /**
+     * @brief 处理完队列中剩余的 piece 后停止所有校验线程
+     */
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            closed_ = true;
+        }
+        not_empty_.notify_all();
+        not_full_.notify_all();
+
+        for (auto& t : threads_)
+        {
+            if (t.joinable()) t.join();
+        }
+    }
+
+private:
+    void run()
+    {
+        while (true)
+        {
+            VerifyJob job;
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                not_empty_.wait(lock, [this]() { return !jobs_.empty() || closed_; });
+                if (jobs_.empty()) return;
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+            }
+            not_full_.notify_one();
+
+            bool ok = job.verified ||
+                      (job.digest.size() == 20 &&
+                       hashes_.matches(static_cast<size_t>(job.piece_index),
+                                       reinterpret_cast<const uint8_t*>(job.digest.data())));
+
+            // 写入共享缓冲区（每个 piece 对应的区间互不重叠）
+            if (!ok ||
+                job.piece_offset + static_cast<int64_t>(job.data.size()) > static_cast<int64_t>(out_buf_.size()))
+            {
+                mark_piece_retry(queue_, job.piece_index);
+                continue;
+            }
+            std::memcpy(out_buf_.data() + job.piece_offset, job.data.data(), job.data.size());
+            mark_piece_done(queue_, job.piece_index);
+        }
+    }
+
+    PieceWorkQueue& queue_;
+    const PieceHashTable& hashes_;
+    std::vector<char>& out_buf_;
+    const size_t capacity_;
+
+    std::mutex mu_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<VerifyJob> jobs_;
+    bool closed_ = false;
+    std::vector<std::thread> threads_;
+};
+
+void download_worker(
+    const std::string& peer_addr,
+    const std::string& info_hash,
+    const std::string& my_peer_id,
+    int64_t total_length,
+    int64_t piece_length,
+    int64_t num_pieces,
+    PieceWorkQueue* queue,
+    PieceVerifier* verifier,
+    const V2PieceLayer* v2 = nullptr,
+    size_t pipeline_depth = default_pipeline_depth)
+{
+    std::string peer_host;
+    int peer_port = 0;
+    parse_host_port(peer_addr, peer_host, peer_port);
+
+    SOCKET sock = INVALID_SOCKET;
+    std::unique_ptr<PeerConnection> conn;
+    std::unique_ptr<PeerPipeline> pipeline;
+
+    try
+    {
+        sock = tcp_connect(peer_host, peer_port);
+        conn = std::make_unique<PeerConnection>(sock);
+        bool peer_supports_extensions = false;
+        bool peer_supports_v2 = false;
+        (void)perform_handshake(*conn, info_hash, my_peer_id, true, &peer_supports_extensions, v2 != nullptr,
+                                &peer_supports_v2);
+
+        std::string bitfield = recv_bitfield_payload(*conn);
+        conn->queue_message(2);
+        wait_for_unchoke(*conn);
+
+        // 对方的扩展握手由流水线异步处理，从中取 reqq 限制在途 request 数
+        if (peer_supports_extensions) send_extension_handshake(*conn);
+
+        // v1 torrent 随 block 到达增量计算 SHA-1（数据还在缓存里），校验线程只需比较摘要；
+        // v2 torrent 在接收时逐 block 校验（对方不支持 v2 时只能整 piece 校验）
+        pipeline = std::make_unique<PeerPipeline>(*conn, pipeline_depth, v2 == nullptr, v2, peer_supports_v2);
+
+        bool more_pieces = true;
+        while (queue->remaining.load() > 0)
+        {
+            // 流水线里未请求的 block 不够时提前领取下一个 piece，使 request 跨 piece 连续；
+            // 只有流水线空了才阻塞等待校验结果
+            while (more_pieces && pipeline->wants_piece())
+            {
+                int piece_index = pipeline->idle() ? wait_next_piece(*queue, bitfield, num_pieces)
+                                                   : acquire_next_piece(*queue, bitfield, num_pieces);
+                if (piece_index < 0)
+                {
+                    more_pieces = false;
+                    break;
+                }
+
+                int64_t piece_offset = static_cast<int64_t>(piece_index) * piece_length;
+                int64_t piece_size = std::min(piece_length, total_length - piece_offset);
+                if (piece_size < 0)
+                {
+                    mark_piece_retry(*queue, piece_index);
+                    throw std::runtime_error("Invalid piece size");
+                }
+                pipeline->add_piece(piece_index, piece_size);
+            }
+            if (pipeline->idle())
+            {
+                // 这个 peer 没有可下载的 piece（或都被领走了，且没有待校验的）
+                break;
+            }
+
+            // 收完即交给校验线程池比较摘要并写入缓冲区；
+            // 返回 nullptr 表示流水线需要再领取一个 piece
+            std::unique_ptr<PipelinePiece> piece = pipeline->next_completed(more_pieces);
+            if (!piece) continue;
+            more_pieces = true; // 校验失败的 piece 会回到队列，完成一个后重新尝试领取
+
+            VerifyJob job;
+            job.piece_index = piece->index;
+            job.piece_offset = static_cast<int64_t>(piece->index) * piece_length;
+            if (piece->hasher) job.digest = piece->hasher->digest(); // hasher 引用 data，先于 move 取摘要
+            job.data = std::move(piece->data);
+            job.verified = v2 != nullptr;
+            verifier->submit(std::move(job));
+        }
+
+        closesocket(sock);
+        sock = INVALID_SOCKET;
+    }
+    catch (...)
+    {
+        if (pipeline)
+        {
+            for (int piece_index : pipeline->pending_pieces()) mark_piece_retry(*queue, piece_index);
+        }
+        if (sock != INVALID_SOCKET)
+        {
+            closesocket(sock);
+        }
+        throw;
+    }
+}
+
+
+/**
+ * @brief 从 tracker 响应中解析 peers 列表
+
+ * 
+ * Tracker 返回的 peers 是紧凑格式：每 6 字节表示一个 peer
+ * - 前 4 字节: IP 地址（大端序）
+ * - 后 2 字节: 端口号（大端序）
+ * 
+ * @param peers_data 紧凑格式的 peers 数据
+ * @param peers 解析出的 peer 追加到这里（格式: "IP:port"）
+ * @return 已解析的字节数（6 的倍数）；不足 6 字节的尾部留给调用方
+ */
+size_t parse_compact_peers(std::string_view peers_data, std::vector<std::string>& peers)
+{
+    size_t i = 0;
+
+    // 每 6 字节是一个 peer
+    for (; i + 5 < peers_data.size(); i += 6)
+    {
+        // 提取 IP 地址（4 字节）
+        unsigned char ip1 = static_cast<unsigned char>(peers_data[i]);
+        unsigned char ip2 = static_cast<unsigned char>(peers_data[i + 1]);
+        unsigned char ip3 = static_cast<unsigned char>(peers_data[i + 2]);
+        unsigned char ip4 = static_cast<unsigned char>(peers_data[i + 3]);
+        
+        // 提取端口号（2 字节，大端序）
+        uint16_t port = (static_cast<unsigned char>(peers_data[i + 4]) << 8) |
+                        static_cast<unsigned char>(peers_data[i + 5]);
+        
+        // 格式化为 "IP:port"
+        std::ostringstream peer;
+        peer << static_cast<int>(ip1) << "."
+             << static_cast<int>(ip2) << "."
+             << static_cast<int>(ip3) << "."
+             << static_cast<int>(ip4) << ":"
+             << port;
+        
+        peers.push_back(peer.str());
+    }
+    
+    return i;
+}
+
+// ============================================================================
+// Tracker 响应流式解析
+// ============================================================================
+
+struct TrackerResponse
+{
+    std::vector<std::string> peers; // "IP:port"
+    int64_t interval = 0;
+};
+
+/**
+ * @brief 边接收边解析 tracker 响应的 SAX 回调
+ *
+ * 只关心顶层的 "peers"、"interval" 和 "failure reason"：
+ * - 紧凑格式 peers（字符串）：每凑满 6 字节就转成一个 peer，跨块的不完整记录暂存在 partial_
+ * - 字典格式 peers（列表，每项 {"ip": ..., "port": ...}）：每个字典结束时输出一个 peer
+ * 其余字段直接跳过，不会在内存中保留。
+ */
+class TrackerResponseHandler : public BencodeHandler
+{
+public:
+    explicit TrackerResponseHandler(TrackerResponse& out) : out_(out) {}
+
+    bool saw_peers() const { return saw_peers_; }
+
+    void on_dict_begin() override
+    {
+        depth_++;
+        if (in_peer_list() && depth_ == 3)
+        {
+            peer_ip_.clear();
+            peer_port_ = -1;
+        }
+    }
+
+    void on_list_begin() override
+    {
+        depth_++;
+        if (depth_ == 2 && top_key_ == "peers") saw_peers_ = true;
+    }
+
+    void on_end() override
+    {
+        if (in_peer_list() && depth_ == 3 && !peer_ip_.empty() && peer_port_ >= 0 && peer_port_ <= 65535)
+        {
+            out_.peers.push_back(peer_ip_ + ":" + std::to_string(peer_port_));
+        }
+        depth_--;
+    }
+
+    void on_key(std::string_view key) override
+    {
+        if (depth_ == 1) top_key_.assign(key);
+        else if (depth_ == 3) peer_key_.assign(key);
+    }
+
+    void on_string_begin(uint64_t /*length*/) override
+    {
+        if (depth_ == 1 && top_key_ == "peers")
+        {
+            saw_peers_ = true;
+            partial_len_ = 0;
+        }
+        else if (in_peer_list() && depth_ == 3 && peer_key_ == "ip")
+        {
+            peer_ip_.clear();
+        }
+    }
+
+    void on_string_data(std::string_view data) override
+    {
+        if (depth_ == 1 && top_key_ == "peers")
+        {
+            append_compact(data);
+        }
+        else if (depth_ == 1 && top_key_ == "failure reason")
+        {
+            failure_.append(data.substr(0, std::min(data.size(), kMaxText - std::min(kMaxText, failure_.size()))));
+        }
+        else if (in_peer_list() && depth_ == 3 && peer_key_ == "ip")
+        {
+            peer_ip_.append(data.substr(0, std::min(data.size(), kMaxText - std::min(kMaxText, peer_ip_.size()))));
+        }
+    }
+
+    void on_string_end() override
+    {
+        if (depth_ == 1 && top_key_ == "failure reason")
+        {
+            throw std::runtime_error("Tracker failure: " + failure_);
+        }
+    }
+
+    void on_int(int64_t value) override
+    {
+        if (depth_ == 1 && top_key_ == "interval") out_.interval = value;
+        else if (in_peer_list() && depth_ == 3 && peer_key_ == "port") peer_port_ = value;
+    }
+
+private:
+    static constexpr size_t kMaxText = 1024; // failure reason / ip 的长度上限
+
+    bool in_peer_list() const { return depth_ >= 2 && top_key_ == "peers"; }
+
+    void append_compact(std::string_view data)
+    {
+        // 先补齐上一块遗留的不完整记录
+        if (partial_len_ > 0)
+        {
+            size_t n = std::min(data.size(), sizeof(partial_) - partial_len_);
+            std::memcpy(partial_ + partial_len_, data.data(), n);
+            partial_len_ += n;
+            data.remove_prefix(n);
+            if (partial_len_ < sizeof(partial_)) return;
+            parse_compact_peers(std::string_view(partial_, sizeof(partial_)), out_.peers);
+            partial_len_ = 0;
+        }
+
+        size_t used = parse_compact_peers(data, out_.peers);
+        partial_len_ = data.size() - used;
+        std::memcpy(partial_, data.data() + used, partial_len_);
+    }
+
+    TrackerResponse& out_;
+    int depth_ = 0;
+    std::string top_key_;
+    std::string peer_key_;
+    std::string peer_ip_;
+    int64_t peer_port_ = -1;
+    std::string failure_;
+    char partial_[6];
+    size_t partial_len_ = 0;
+    bool saw_peers_ = false;
+};
+
+/**
+ * @brief 向 tracker 发送 announce 请求，边接收边解析响应
+ *
+ * @param url 完整的 announce URL（含查询参数）
+ * @throws std::runtime_error tracker 返回 failure reason、响应不完整或缺少 peers
+ */
+TrackerResponse announce_to_tracker(const std::string& url)
+{
+    TrackerResponse response;
+    TrackerResponseHandler handler(response);
+    BencodeStreamParser parser(handler);
+
+    http_get_stream(url, [&](std::string_view chunk) {
+        if (!parser.done()) parser.feed(chunk);
+    });
+
+    if (!parser.done()) throw std::runtime_error("Truncated tracker response");
+    if (!handler.saw_peers()) throw std::runtime_error("Tracker response has no peers");
+    return response;
+}
+
+// ============================================================================
+// 本地文件校验（recheck 命令用）
+// ============================================================================
+
+/**
+ * @brief 只读内存映射一个文件（RAII）
+ */
+struct MappedFile
+{
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    explicit MappedFile(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        struct stat st{};
+        if (::fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Failed to stat file: " + path);
+        }
+
+        size = static_cast<size_t>(st.st_size);
+        if (size > 0)
+        {
+            void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::runtime_error("Failed to mmap file: " + path);
+            }
+            data = static_cast<const uint8_t*>(p);
+            // 顺序读为主，提示内核加大预读
+            ::madvise(p, size, MADV_SEQUENTIAL);
+            ::madvise(p, size, MADV_WILLNEED);
+        }
+        ::close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (data != nullptr) ::munmap(const_cast<uint8_t*>(data), size);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+/**
+ * @brief recheck 的本地数据：torrent 中的各个文件按顺序拼接成一个 payload，每个文件各自 mmap
+ *
+ * 单文件 torrent 的 path 就是该文件；多文件 torrent 的 path 是根目录，其下按 torrent 中的路径
+ * 查找各文件（与 create 生成多文件 torrent 时的布局相同）。多文件时不存在的文件视为没有数据。
+ */
+struct LocalPayload
+{
+    struct File
+    {
+        int64_t offset = 0;              // 在整个 payload 中的起始偏移
+        int64_t length = 0;              // torrent 中的长度
+        std::unique_ptr<MappedFile> map; // 为空：文件不存在
+    };
+
+    std::vector<File> files;
+
+    static LocalPayload open(const InfoDict& info, const std::string& path)
+    {
+        LocalPayload payload;
+        if (info.length >= 0)
+        {
+            payload.files.push_back(File{0, info.length, std::make_unique<MappedFile>(path)});
+            return payload;
+        }
+
+        if (!std::filesystem::is_directory(path))
+        {
+            throw std::runtime_error("Multi-file torrent needs a directory: " + path);
+        }
+
+        int64_t offset = 0;
+        for (const TorrentFile& f : info.files)
+        {
+            std::filesystem::path full = path;
+            for (std::string_view part : f.path)
+            {
+                if (part.empty() || part == "." || part == ".." || part.find('/') != std::string_view::npos)
+                {
+                    throw std::runtime_error("Invalid torrent field: path");
+                }
+                full /= std::string(part);
+            }
+
+            File file{offset, f.length, nullptr};
+            if (std::filesystem::is_regular_file(full)) file.map = std::make_unique<MappedFile>(full.string());
+            payload.files.push_back(std::move(file));
+            offset += f.length;
+        }
+        return payload;
+    }
+
+    /**
+     * @brief 本地实际存在的 payload 字节数
+     */
+    int64_t available_bytes() const
+    {
+        int64_t total = 0;
+        for (const File& f : files)
+        {
+            if (f.map) total += std::min(f.length, static_cast<int64_t>(f.map->size));
+        }
+        return total;
+    }
+
+    /**
+     * @brief payload 中 [offset, offset+len) 的数据
+     *
+     * 落在一个文件内时直接返回 mmap 指针；跨越多个文件时拷贝进 scratch 并返回 scratch.data()。
+     *
+     * @return 有任何部分缺数据时返回 nullptr
+     */
+    const uint8_t* range(int64_t offset, size_t len, std::vector<uint8_t>& scratch) const
+    {
+        auto it = std::upper_bound(files.begin(), files.end(), offset,
+                                   [](int64_t off, const File& f) { return off < f.offset; });
+        size_t fi = static_cast<size_t>(std::distance(files.begin(), it)) - 1;
+
+        const int64_t end = offset + static_cast<int64_t>(len);
+        if (end <= files[fi].offset + files[fi].length) return file_data(files[fi], offset, len);
+
+        scratch.resize(len);
+        for (int64_t pos = offset; pos < end; fi++)
+        {
+            const File& f = files[fi];
+            size_t want = static_cast<size_t>(std::min(end, f.offset + f.length) - pos);
+            if (want == 0) continue;
+
+            const uint8_t* src = file_data(f, pos, want);
+            if (src == nullptr) return nullptr;
+            std::memcpy(scratch.data() + (pos - offset), src, want);
+            pos += static_cast<int64_t>(want);
+        }
+        return scratch.data();
+    }
+
+private:
+    static const uint8_t* file_data(const File& f, int64_t offset, size_t len)
+    {
+        size_t in_file = static_cast<size_t>(offset - f.offset);
+        if (!f.map || in_file + len > f.map->size) return nullptr;
+        return f.map->data + in_file;
+    }
+};
+
+/**
+ * @brief 并行校验本地数据中的每个 piece
+ *
+ * 所有核心从一个原子计数器领取连续的 piece 区间（每次 chunk 个），
+ * 区间内落在单个文件里的等长 piece 直接以 mmap 指针喂给 sha1_hash_batch，零拷贝；
+ * 跨文件的 piece 先拷贝进线程自己的缓冲区再单独计算。缺数据的 piece 记为无效。
+ *
+ * @return 每个 piece 是否有效（1/0）
+ */
+std::vector<uint8_t> recheck_pieces(const LocalPayload& payload, int64_t total_length, int64_t piece_length,
+                                    const PieceHashTable& hashes, size_t num_threads)
+{
+    const int64_t num_pieces = static_cast<int64_t>(hashes.size());
+    std::vector<uint8_t> valid(static_cast<size_t>(num_pieces), 0);
+
+    const int64_t chunk = 64;
+    std::atomic<int64_t> next{0};
+
+    auto worker = [&]() {
+        std::vector<const uint8_t*> ptrs;
+        std::vector<int64_t> indices;
+        std::vector<uint8_t> digests;
+        std::vector<uint8_t> scratch;
+
+        while (true)
+        {
+            int64_t first = next.fetch_add(chunk);
+            if (first >= num_pieces) return;
+            int64_t last = std::min(num_pieces, first + chunk);
+
+            ptrs.clear();
+            indices.clear();
+            for (int64_t i = first; i < last; i++)
+            {
+                int64_t offset = i * piece_length;
+                int64_t size = std::min(piece_length, total_length - offset);
+                if (size <= 0) continue;
+                const uint8_t* data = payload.range(offset, static_cast<size_t>(size), scratch);
+                if (data == nullptr) continue;
+
+                // 最后一个 piece 长度不同、跨文件的 piece 在 scratch 里（下一次会被覆盖），单独计算
+                if (size != piece_length || data == scratch.data())
+                {
+                    uint8_t digest[20];
+                    SHA1 sha1;
+                    sha1.update(data, static_cast<size_t>(size));
+                    sha1.final(digest);
+                    valid[static_cast<size_t>(i)] = hashes.matches(static_cast<size_t>(i), digest);
+                    continue;
+                }
+                ptrs.push_back(data);
+                indices.push_back(i);
+            }
+
+            digests.resize(ptrs.size() * 20);
+            sha1_hash_batch(ptrs.data(), ptrs.size(), static_cast<size_t>(piece_length),
+                            reinterpret_cast<uint8_t(*)[20]>(digests.data()));
+
+            for (size_t k = 0; k < indices.size(); k++)
+            {
+                int64_t i = indices[k];
+                valid[static_cast<size_t>(i)] = hashes.matches(static_cast<size_t>(i), &digests[k * 20]);
+            }
+        }
+    };
+
+    num_threads = std::max<size_t>(1, num_threads);
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (size_t t = 0; t < num_threads; t++)
+    {
+        threads.emplace_back(worker);
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    return valid;
+}
+
+/**
+ * @brief 把 piece 有效性数组打包为 BitTorrent bitfield（高位在前）
+ */
+std::string pack_bitfield(const std::vector<uint8_t>& bits)
+{
+    std::string bitfield((bits.size() + 7) / 8, '\0');
+    for (size_t i = 0; i < bits.size(); i++)
+    {
+        if (bits[i]) bitfield[i / 8] = static_cast<char>(bitfield[i / 8] | (0x80 >> (i % 8)));
+    }
+    return bitfield;
+}
+
+// ============================================================================
+// 制作 torrent（create 命令用）
+// ============================================================================
+//
+// 流水线：
+//   reader 线程 ×R ──(满 buffer 队列)──> SHA-1 线程 ×H ──> pieces[index]
+//        ↑                                      │
+//        └────────────(空 buffer 池)─────────────┘
+//
+// reader 从原子计数器领取 piece 序号，用 pread 把该 piece 覆盖的字节
+// （可能跨越多个文件）读进池中的 buffer；SHA-1 线程每次取出一批 buffer
+// 用 sha1_hash_batch 计算，把摘要写到 pieces 中对应位置后归还 buffer。
+// buffer 池大小固定，内存占用 = 池大小 × piece 长度，与数据总量无关。
+
+/**
+ * @brief 有界阻塞队列（多生产者 / 多消费者）
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(std::max<size_t>(1, capacity)) {}
+
+    /**
+     * @brief 入队，队列满时阻塞；队列已关闭返回 false
+     */
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mu_);
+        not_full_.wait(lock, [this]() { return items_.size() < capacity_ || closed_; });
+        if (closed_) return false;
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief 出队，队列空时阻塞；已关闭且取空时返回 false
+     */
+    bool pop(T& out)
+    {
+        std::unique_lock<std::mutex> lock(mu_);
+        not_empty_.wait(lock, [this]() { return !items_.empty() || closed_; });
+        if (items_.empty()) return false;
+        out = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief 非阻塞出队
+     */
+    bool try_pop(T& out)
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (items_.empty()) return false;
+        out = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            closed_ = true;
+        }
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    std::mutex mu_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<T> items_;
+    bool closed_ = false;
+};
+
+/**
+ * @brief 待制作 torrent 中的一个文件
+ */
+struct CreateFileEntry
+{
+    std::string full_path;               // 磁盘上的路径
+    std::vector<std::string> path;       // torrent 中的相对路径分量
+    int64_t length = 0;
+    int64_t offset = 0;                  // 在整个 payload 中的起始偏移
+};
+
+/**
+ * @brief 收集文件列表：单个文件，或目录下所有普通文件（按路径排序）
+ */
+std::vector<CreateFileEntry> collect_create_files(const std::filesystem::path& root)
+{
+    std::vector<CreateFileEntry> files;
+
+    if (std::filesystem::is_regular_file(root))
+    {
+        CreateFileEntry e;
+        e.full_path = root.string();
+        e.length = static_cast<int64_t>(std::filesystem::file_size(root));
+        files.push_back(e);
+        return files;
+    }
+
+    if (!std::filesystem::is_directory(root))
+    {
+        throw std::runtime_error("Not a file or directory: " + root.string());
+    }
+
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(root))
+    {
+        if (!entry.is_regular_file()) continue;
+
+        CreateFileEntry e;
+        e.full_path = entry.path().string();
+        e.length = static_cast<int64_t>(entry.file_size());
+        for (const auto& part : std::filesystem::relative(entry.path(), root))
+        {
+            e.path.push_back(part.string());
+        }
+        files.push_back(e);
+    }
 
-void mark_piece_done(PieceWorkQueue& q, int piece_index)
-{
-    std::lock_guard<std::mutex> lock(q.mu);
-    if (piece_index < 0) return;
-    size_t idx = static_cast<size_t>(piece_index);
-    if (idx >= q.state.size()) return;
+    std::sort(files.begin(), files.end(), [](const CreateFileEntry& a, const CreateFileEntry& b) {
+        return a.path < b.path;
+    });
 
-    if (q.state[idx] == 1)
+    if (files.empty())
     {
-        q.state[idx] = 2;
-        q.remaining.fetch_sub(1);
+        throw std::runtime_error("No files found in: " + root.string());
     }
+
+    return files;
 }
 
-void mark_piece_retry(PieceWorkQueue& q, int piece_index)
+/**
+ * @brief 自动选择 piece 长度
+ *
+ * 2 的幂，16 KiB ~ 16 MiB 之间，使 piece 数大约不超过 2000：
+ * piece 太多 .torrent 文件会很大，太少则校验/重传粒度过粗。
+ */
+int64_t auto_piece_length(int64_t total_length)
 {
-    std::lock_guard<std::mutex> lock(q.mu);
-    if (piece_index < 0) return;
-    size_t idx = static_cast<size_t>(piece_index);
-    if (idx >= q.state.size()) return;
-
-    if (q.state[idx] == 1)
+    int64_t piece_length = 16 * 1024;
+    while (piece_length < 16 * 1024 * 1024 && total_length / piece_length > 2000)
     {
-        q.state[idx] = 0;
+        piece_length *= 2;
     }
+    return piece_length;
 }
 
-void download_worker(
-    const std::string& peer_addr,
-    const std::string& info_hash,
-    const std::string& my_peer_id,
-    int64_t total_length,
-    int64_t piece_length,
-    const std::string& pieces_blob,
-    PieceWorkQueue* queue,
-    std::vector<char>* out_buf)
+/**
+ * @brief 流水线并行计算 payload 的 pieces 字段
+ *
+ * @param files 文件列表（offset 已计算好）
+ * @param total_length 所有文件总长度
+ * @param piece_length piece 长度
+ * @param num_readers reader 线程数
+ * @param num_hashers SHA-1 线程数
+ * @return 所有 piece 的 SHA-1 拼接（每个 20 字节）
+ */
+std::string hash_payload_pieces(const std::vector<CreateFileEntry>& files, int64_t total_length, int64_t piece_length,
+                                size_t num_readers, size_t num_hashers)
 {
-    std::string peer_host;
-    int peer_port = 0;
-    parse_host_port(peer_addr, peer_host, peer_port);
-
-    SOCKET sock = INVALID_SOCKET;
-    int current_piece = -1;
-
-    try
+    struct PieceBuffer
     {
-        sock = tcp_connect(peer_host, peer_port);
-        (void)perform_handshake(sock, info_hash, my_peer_id);
+        int64_t index = 0;
+        size_t size = 0;
+        std::vector<uint8_t> data;
+    };
+
+    const int64_t num_pieces = (total_length + piece_length - 1) / piece_length;
+    std::string pieces(static_cast<size_t>(num_pieces) * 20, '\0');
+
+    num_readers = std::max<size_t>(1, num_readers);
+    num_hashers = std::max<size_t>(1, num_hashers);
+    const size_t lanes = static_cast<size_t>(std::max(1, sha1_batch_lanes()));
+    const size_t pool_size = std::max(num_readers * 2, num_hashers * lanes * 2);
+
+    BoundedQueue<std::unique_ptr<PieceBuffer>> free_buffers(pool_size);
+    BoundedQueue<std::unique_ptr<PieceBuffer>> full_buffers(pool_size);
+    for (size_t i = 0; i < pool_size; i++)
+    {
+        auto buf = std::make_unique<PieceBuffer>();
+        buf->data.resize(static_cast<size_t>(piece_length));
+        free_buffers.push(std::move(buf));
+    }
 
-        std::string bitfield = recv_bitfield_payload(sock);
-        send_peer_message(sock, 2, "");
-        wait_for_unchoke(sock);
+    std::atomic<int64_t> next_piece{0};
+    std::string error;
+    std::mutex error_mu;
+    auto record_error = [&](const std::string& what) {
+        std::lock_guard<std::mutex> lock(error_mu);
+        if (error.empty()) error = what;
+    };
+
+    // 读取 payload 中 [offset, offset+len) 的字节，可能跨越多个文件
+    auto read_range = [&](int64_t offset, size_t len, uint8_t* out, int& cached_fd, size_t& cached_file) {
+        auto it = std::upper_bound(files.begin(), files.end(), offset,
+                                   [](int64_t off, const CreateFileEntry& f) { return off < f.offset; });
+        size_t fi = static_cast<size_t>(std::distance(files.begin(), it)) - 1;
+
+        size_t done = 0;
+        while (done < len)
+        {
+            const CreateFileEntry& f = files[fi];
+            int64_t in_file = offset + static_cast<int64_t>(done) - f.offset;
+            size_t want = static_cast<size_t>(std::min<int64_t>(f.length - in_file, static_cast<int64_t>(len - done)));
+            if (want == 0)
+            {
+                fi++;
+                continue;
+            }
 
-        int64_t num_pieces = static_cast<int64_t>(pieces_blob.size() / 20);
+            if (cached_fd < 0 || cached_file != fi)
+            {
+                if (cached_fd >= 0) ::close(cached_fd);
+                cached_fd = ::open(f.full_path.c_str(), O_RDONLY);
+                cached_file = fi;
+                if (cached_fd < 0) throw std::runtime_error("Failed to open file: " + f.full_path);
+                ::posix_fadvise(cached_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            }
 
-        while (queue->remaining.load() > 0)
-        {
-            current_piece = acquire_next_piece(*queue, bitfield, num_pieces);
-            if (current_piece < 0)
+            while (want > 0)
             {
-                // 这个 peer 没有可下载的 piece（或都被领走了）
-                break;
+                ssize_t n = ::pread(cached_fd, out + done, want, static_cast<off_t>(in_file));
+                if (n <= 0) throw std::runtime_error("Failed to read file: " + f.full_path);
+                done += static_cast<size_t>(n);
+                in_file += n;
+                want -= static_cast<size_t>(n);
             }
+            fi++;
+        }
+    };
 
-            int64_t piece_offset = static_cast<int64_t>(current_piece) * piece_length;
-            int64_t piece_size = std::min(piece_length, total_length - piece_offset);
-            if (piece_size < 0)
+    auto reader = [&]() {
+        int cached_fd = -1;
+        size_t cached_file = 0;
+        try
+        {
+            while (true)
             {
-                throw std::runtime_error("Invalid piece size");
+                int64_t index = next_piece.fetch_add(1);
+                if (index >= num_pieces) break;
+
+                std::unique_ptr<PieceBuffer> buf;
+                if (!free_buffers.pop(buf)) break;
+
+                int64_t offset = index * piece_length;
+                buf->index = index;
+                buf->size = static_cast<size_t>(std::min(piece_length, total_length - offset));
+                read_range(offset, buf->size, buf->data.data(), cached_fd, cached_file);
+
+                if (!full_buffers.push(std::move(buf))) break;
             }
+        }
+        catch (const std::exception& e)
+        {
+            record_error(e.what());
+            free_buffers.close();
+            full_buffers.close();
+        }
+        if (cached_fd >= 0) ::close(cached_fd);
+    };
 
-            std::string expected_piece_hash = pieces_blob.substr(static_cast<size_t>(current_piece) * 20, 20);
+    auto hasher = [&]() {
+        std::vector<std::unique_ptr<PieceBuffer>> batch;
+        std::vector<const uint8_t*> ptrs;
+        std::vector<uint8_t> digests;
 
-            std::string piece_data = download_piece_from_peer(sock, current_piece, piece_size);
-            std::string actual_hash = SHA1::hash(piece_data);
-            if (actual_hash != expected_piece_hash)
+        while (true)
+        {
+            batch.clear();
+            std::unique_ptr<PieceBuffer> buf;
+            if (!full_buffers.pop(buf)) return;
+            batch.push_back(std::move(buf));
+            while (batch.size() < lanes && full_buffers.try_pop(buf))
             {
-                mark_piece_retry(*queue, current_piece);
-                current_piece = -1;
-                continue;
+                batch.push_back(std::move(buf));
             }
 
-            // 写入共享缓冲区（每个 piece 对应的区间互不重叠）
-            if (piece_offset + piece_size > static_cast<int64_t>(out_buf->size()))
+            // 等长的（除最后一个 piece 外都是）一起批量哈希
+            ptrs.clear();
+            for (const auto& b : batch)
             {
-                throw std::runtime_error("Output buffer overflow");
+                if (b->size == static_cast<size_t>(piece_length)) ptrs.push_back(b->data.data());
             }
-            std::memcpy(out_buf->data() + piece_offset, piece_data.data(), static_cast<size_t>(piece_size));
+            digests.resize(ptrs.size() * 20);
+            sha1_hash_batch(ptrs.data(), ptrs.size(), static_cast<size_t>(piece_length),
+                            reinterpret_cast<uint8_t(*)[20]>(digests.data()));
 
-            mark_piece_done(*queue, current_piece);
-            current_piece = -1;
+            size_t k = 0;
+            for (auto& b : batch)
+            {
+                char* dst = &pieces[static_cast<size_t>(b->index) * 20];
+                if (b->size == static_cast<size_t>(piece_length))
+                {
+                    std::memcpy(dst, &digests[k * 20], 20);
+                    k++;
+                }
+                else
+                {
+                    SHA1 sha1;
+                    sha1.update(b->data.data(), b->size);
+                    sha1.final(reinterpret_cast<uint8_t*>(dst));
+                }
+                free_buffers.push(std::move(b));
+            }
         }
+    };
 
-        closesocket(sock);
-        sock = INVALID_SOCKET;
-    }
-    catch (...)
+    std::vector<std::thread> readers;
+    std::vector<std::thread> hashers;
+    for (size_t i = 0; i < num_readers; i++) readers.emplace_back(reader);
+    for (size_t i = 0; i < num_hashers; i++) hashers.emplace_back(hasher);
+
+    for (auto& t : readers) t.join();
+    full_buffers.close();
+    for (auto& t : hashers) t.join();
+
+    if (!error.empty())
     {
-        if (current_piece >= 0)
-        {
-            mark_piece_retry(*queue, current_piece);
-        }
-        if (sock != INVALID_SOCKET)
-        {
-            closesocket(sock);
-        }
-        throw;
+        throw std::runtime_error(error);
     }
+
+    return pieces;
 }
 
+// ============================================================================
+// 批量输出（info / magnet_info 用）
+// ============================================================================
+//
+// stdout 开了 unitbuf，逐行 << std::endl 意味着每行一次 write 系统调用；
+// 十万级 piece 的 torrent 要刷几十万次。这里先把全部输出拼进一个缓冲区，最后一次写出。
 
 /**
- * @brief 从 tracker 响应中解析 peers 列表
-
- * 
- * Tracker 返回的 peers 是紧凑格式：每 6 字节表示一个 peer
- * - 前 4 字节: IP 地址（大端序）
- * - 后 2 字节: 端口号（大端序）
- * 
- * @param peers_data 紧凑格式的 peers 数据
- * @return std::vector<std::string> 解析后的 peer 列表（格式: "IP:port"）
+ * @brief 把 pieces（20 字节 SHA-1 拼接）逐行以十六进制追加到 out
  */
-std::vector<std::string> parse_peers(const std::string& peers_data)
+void append_piece_hashes(std::string& out, std::string_view pieces)
 {
-    std::vector<std::string> peers;
-    
-    // 每 6 字节是一个 peer
-    for (size_t i = 0; i + 5 < peers_data.size(); i += 6)
+    size_t count = pieces.size() / 20;
+    size_t pos = out.size();
+    out.resize(pos + count * 41);
+
+    char* dst = &out[pos];
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(pieces.data());
+    for (size_t i = 0; i < count; i++)
     {
-        // 提取 IP 地址（4 字节）
-        unsigned char ip1 = static_cast<unsigned char>(peers_data[i]);
-        unsigned char ip2 = static_cast<unsigned char>(peers_data[i + 1]);
-        unsigned char ip3 = static_cast<unsigned char>(peers_data[i + 2]);
-        unsigned char ip4 = static_cast<unsigned char>(peers_data[i + 3]);
-        
-        // 提取端口号（2 字节，大端序）
-        uint16_t port = (static_cast<unsigned char>(peers_data[i + 4]) << 8) |
-                        static_cast<unsigned char>(peers_data[i + 5]);
-        
-        // 格式化为 "IP:port"
-        std::ostringstream peer;
-        peer << static_cast<int>(ip1) << "."
-             << static_cast<int>(ip2) << "."
-             << static_cast<int>(ip3) << "."
-             << static_cast<int>(ip4) << ":"
-             << port;
-        
-        peers.push_back(peer.str());
+        hex_encode(src + i * 20, 20, dst);
+        dst[40] = '\n';
+        dst += 41;
     }
-    
-    return peers;
+}
+
+void write_stdout(const std::string& out)
+{
+    std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+    std::cout.flush();
 }
 
 /**
- * @brief 程序主入口
+ * @brief 程序主入口：解析命令行并执行对应的命令；出错时抛出异常，由 main 统一报告
  * 
  * 命令行用法:
  *   ./your_program decode <encoded_value>
  *   ./your_program info <torrent_file>
+ *   ./your_program recheck <torrent_file> <path> [-o <bitfield_output>]
+ *   ./your_program create -o <torrent_file> [-a <announce_url>] [-l <piece_length>] <path>
  * 
  * 示例:
  *   ./your_program decode "5:hello"              -> 输出: "hello"
@@ -1758,7 +2811,7 @@ std::vector<std::string> parse_peers(const std::string& peers_data)
  * @param argv 命令行参数数组
  * @return int 程序退出码（0 表示成功，非 0 表示错误）
  */
-int main(int argc, char* argv[]) 
+int run_command(int argc, char* argv[])
 {
     // 设置 stdout 和 stderr 为无缓冲模式
     // 确保每次输出后立即刷新，便于调试和测试
@@ -1791,12 +2844,14 @@ int main(int argc, char* argv[])
         // 获取要解码的 Bencode 编码值
         std::string encoded_value = argv[2];
         
-        // 调用解码函数进行 Bencode 解码
-        json decoded_value = decode_bencoded_value(encoded_value);
+        // 解码到 arena 中的值树（整棵树随 arena 一次释放）
+        BencodeArena arena;
+        const BencodeValue& decoded_value = BencodeValue::parse(encoded_value, arena);
         
-        // 将解码结果以 JSON 格式输出到 stdout
-        // dump() 方法将 JSON 对象序列化为字符串
-        std::cout << decoded_value.dump() << std::endl;
+        // 将解码结果以 JSON 格式输出到 stdout（格式与 json::dump() 一致）
+        std::string out;
+        append_json(out, decoded_value);
+        std::cout << out << std::endl;
     }
     else if (command == "info")
     {
@@ -1826,40 +2881,76 @@ int main(int argc, char* argv[])
         std::string torrent_file = argv[2];
         std::string file_content = read_file(torrent_file);
         
-        // 解析 Bencode 编码的 torrent 文件
-        json torrent = decode_bencoded_value(file_content);
+        // 解析 torrent 文件（强类型元信息，字段直接指向 file_content）
+        TorrentMeta torrent = TorrentMeta::parse(file_content);
+        const InfoDict& info = torrent.info;
         
-        // 提取并输出 Tracker URL
-        std::string tracker_url = torrent["announce"].get<std::string>();
-        std::cout << "Tracker URL: " << tracker_url << std::endl;
+        // 全部输出先拼进 out，最后一次写出
+        std::string out;
+
+        // 提取并输出 Tracker URL（没有 tracker 的 torrent 不输出这一行）
+        if (torrent.has_tracker())
+        {
+            out += "Tracker URL: ";
+            out += torrent.tracker_url();
+            out += "\n";
+        }
         
+        // v2 torrent（BEP 52）用 file tree 描述文件，没有 length/pieces
+        bool v2 = info.is_v2();
+        std::vector<V2File> v2_files;
+        if (v2) v2_files = parse_v2_file_tree(info);
+
         // 提取并输出文件长度
-        int64_t length = torrent["info"]["length"].get<int64_t>();
-        std::cout << "Length: " << length << std::endl;
+        int64_t length = 0;
+        if (info.length >= 0 || !info.files.empty() || !v2)
+        {
+            length = info.total_length();
+        }
+        else
+        {
+            for (const auto& f : v2_files) length += f.length;
+        }
+        out += "Length: " + std::to_string(length) + "\n";
         
         // 计算并输出 Info Hash
-        // 1. 提取 info 字典的原始 Bencode 数据
-        std::string info_dict = extract_info_dict(file_content);
-        // 2. 计算 SHA-1 哈希
-        std::string info_hash = SHA1::hash(info_dict);
-        // 3. 转换为十六进制并输出
-        std::cout << "Info Hash: " << to_hex(info_hash) << std::endl;
+        // 对 info 字典的原始 Bencode 数据（视图的 raw 区间）计算 SHA-1（纯 v2 torrent 为截断的 SHA-256）
+        std::string info_hash = torrent_info_hash(info);
+        out += "Info Hash: " + to_hex(info_hash) + "\n";
+        if (v2)
+        {
+            std::string_view info_dict = info.raw;
+            out += "Info Hash v2: " + to_hex(SHA256::hash(reinterpret_cast<const uint8_t*>(info_dict.data()), info_dict.size())) + "\n";
+        }
         
         // 提取并输出 Piece Length（每个分片的字节数）
-        int64_t piece_length = torrent["info"]["piece length"].get<int64_t>();
-        std::cout << "Piece Length: " << piece_length << std::endl;
+        out += "Piece Length: " + std::to_string(info.piece_length) + "\n";
         
         // 提取并输出 Piece Hashes
         // pieces 字段是所有分片 SHA-1 哈希值的拼接（每个哈希 20 字节）
-        std::string pieces = torrent["info"]["pieces"].get<std::string>();
-        std::cout << "Piece Hashes:" << std::endl;
-        
-        // 每 20 字节是一个 SHA-1 哈希，遍历并转换为十六进制输出
-        for (size_t i = 0; i < pieces.size(); i += 20)
+        if (info.has_pieces)
+        {
+            out += "Piece Hashes:\n";
+            
+            // 每 20 字节是一个 SHA-1 哈希，逐个转换为十六进制，一行一个
+            append_piece_hashes(out, info.pieces);
+        }
+
+        // v2：每个文件的长度与 merkle 根
+        if (v2)
         {
-            std::string piece_hash = pieces.substr(i, 20);
-            std::cout << to_hex(piece_hash) << std::endl;
+            out += "Files:\n";
+            for (const auto& f : v2_files)
+            {
+                std::string path;
+                for (const auto& part : f.path) path += (path.empty() ? "" : "/") + part;
+                out += path + " " + std::to_string(f.length) + " ";
+                out += f.pieces_root.empty() ? "-" : to_hex(f.pieces_root);
+                out += "\n";
+            }
         }
+
+        write_stdout(out);
     }
     else if (command == "peers")
     {
@@ -1882,17 +2973,16 @@ int main(int argc, char* argv[])
         // 读取并解析 torrent 文件
         std::string torrent_file = argv[2];
         std::string file_content = read_file(torrent_file);
-        json torrent = decode_bencoded_value(file_content);
+        TorrentMeta torrent = TorrentMeta::parse(file_content);
         
         // 获取 tracker URL
-        std::string tracker_url = torrent["announce"].get<std::string>();
+        std::string tracker_url(torrent.tracker_url());
         
         // 获取文件长度
-        int64_t length = torrent["info"]["length"].get<int64_t>();
+        int64_t length = torrent.info.total_length();
         
-        // 计算 info hash（20 字节二进制）
-        std::string info_dict = extract_info_dict(file_content);
-        std::string info_hash = SHA1::hash(info_dict);
+        // 计算 info hash（20 字节二进制），直接取解析时记录的 info 字典原始字节区间
+        std::string info_hash = torrent_info_hash(torrent.info);
         
         // 构建请求 URL
         std::ostringstream url;
@@ -1905,15 +2995,8 @@ int main(int argc, char* argv[])
         url << "&left=" << length;
         url << "&compact=" << 1;
         
-        // 发送请求并获取响应
-        std::string response = http_get(url.str());
-        
-        // 解析 Bencode 响应
-        json tracker_response = decode_bencoded_value(response);
-        
-        // 获取 peers 数据并解析
-        std::string peers_data = tracker_response["peers"].get<std::string>();
-        std::vector<std::string> peers = parse_peers(peers_data);
+        // 发送请求，边接收边解析响应中的 peers
+        std::vector<std::string> peers = announce_to_tracker(url.str()).peers;
         
         // 输出每个 peer
         for (const auto& peer : peers)
@@ -1940,8 +3023,8 @@ int main(int argc, char* argv[])
 
         // 读取 torrent 文件并计算 info_hash（二进制 20 字节）
         std::string file_content = read_file(torrent_file);
-        std::string info_dict = extract_info_dict(file_content);
-        std::string info_hash = SHA1::hash(info_dict);
+        TorrentMeta torrent = TorrentMeta::parse(file_content);
+        std::string info_hash = torrent_info_hash(torrent.info);
 
         // 解析 peer 地址
         std::string peer_host;
@@ -1955,8 +3038,9 @@ int main(int argc, char* argv[])
         try
         {
             sock = tcp_connect(peer_host, peer_port);
+            PeerConnection conn(sock);
 
-            std::string received_peer_id = perform_handshake(sock, info_hash, my_peer_id);
+            std::string received_peer_id = perform_handshake(conn, info_hash, my_peer_id);
             std::cout << "Peer ID: " << to_hex(received_peer_id) << std::endl;
 
             closesocket(sock);
@@ -1995,19 +3079,27 @@ int main(int argc, char* argv[])
 
         // 读取并解析 torrent
         std::string file_content = read_file(torrent_file);
-        json torrent = decode_bencoded_value(file_content);
-
-        std::string tracker_url = torrent["announce"].get<std::string>();
-        int64_t total_length = torrent["info"]["length"].get<int64_t>();
-        int64_t piece_length = torrent["info"]["piece length"].get<int64_t>();
-        std::string pieces_blob = torrent["info"]["pieces"].get<std::string>();
+        TorrentMeta torrent = TorrentMeta::parse(file_content);
+        const InfoDict& info = torrent.info;
+
+        std::string tracker_url(torrent.tracker_url());
+        int64_t piece_length = info.piece_length;
+
+        // 单文件 v2/hybrid torrent 按 SHA-256 merkle 树逐 block 校验（多文件 hybrid 按 v1 校验）；
+        // 纯 v2 没有 length/pieces
+        std::unique_ptr<V2PieceLayer> v2 = load_v2_piece_layer(torrent);
+        int64_t total_length = v2 ? v2->file_length : info.total_length();
+        PieceHashTable hashes;
+        if (info.has_pieces)
+        {
+            hashes = PieceHashTable(info.pieces);
+        }
 
-        // 计算 info_hash（二进制 20 字节）
-        std::string info_dict = extract_info_dict(file_content);
-        std::string info_hash = SHA1::hash(info_dict);
+        // 计算 info_hash（二进制 20 字节，info 字典的原始字节区间）
+        std::string info_hash = torrent_info_hash(info);
 
         // piece 边界检查 + 计算本 piece 实际长度
-        int64_t num_pieces = static_cast<int64_t>(pieces_blob.size() / 20);
+        int64_t num_pieces = v2 ? v2->num_pieces() : static_cast<int64_t>(hashes.size());
         if (piece_index >= num_pieces)
         {
             throw std::runtime_error("piece_index out of range");
@@ -2020,7 +3112,6 @@ int main(int argc, char* argv[])
         }
 
         int64_t piece_size = std::min(piece_length, total_length - piece_offset);
-        std::string expected_piece_hash = pieces_blob.substr(static_cast<size_t>(piece_index) * 20, 20);
 
         // 为 tracker + handshake 统一使用同一个 20 字节 peer_id
         std::string my_peer_id = generate_peer_id();
@@ -2036,11 +3127,7 @@ int main(int argc, char* argv[])
         url << "&left=" << total_length;
         url << "&compact=" << 1;
 
-        std::string tracker_resp_raw = http_get(url.str());
-        json tracker_resp = decode_bencoded_value(tracker_resp_raw);
-
-        std::string peers_data = tracker_resp["peers"].get<std::string>();
-        std::vector<std::string> peers = parse_peers(peers_data);
+        std::vector<std::string> peers = announce_to_tracker(url.str()).peers;
         if (peers.empty())
         {
             throw std::runtime_error("No peers returned by tracker");
@@ -2055,29 +3142,40 @@ int main(int argc, char* argv[])
         try
         {
             sock = tcp_connect(peer_host, peer_port);
+            PeerConnection conn(sock);
 
             // handshake
-            (void)perform_handshake(sock, info_hash, my_peer_id);
+            bool peer_supports_v2 = false;
+            (void)perform_handshake(conn, info_hash, my_peer_id, false, nullptr, v2 != nullptr, &peer_supports_v2);
 
             // 1) 收 bitfield (id=5)
-            std::string bitfield = recv_bitfield_payload(sock);
+            std::string bitfield = recv_bitfield_payload(conn);
             (void)bitfield;
 
             // 2) 发送 interested (id=2)
-            send_peer_message(sock, 2, "");
+            conn.queue_message(2);
 
             // 3) 等 unchoke (id=1)
-            wait_for_unchoke(sock);
-
-            // 4) 下载 piece 数据（按 16KiB block 分段请求）
-            std::string piece_data = download_piece_from_peer(sock, piece_index, piece_size);
+            wait_for_unchoke(conn);
 
-
-            // 5) 校验 piece hash
-            std::string actual_hash = SHA1::hash(piece_data);
-            if (actual_hash != expected_piece_hash)
+            // 4) 下载 piece 数据（按 16KiB block 分段、流水线请求）
+            std::string piece_data;
+            if (v2)
             {
-                throw std::runtime_error("Piece hash mismatch");
+                // v2：每个 block 到达即做 merkle 校验，坏 block 单独重新请求
+                piece_data = download_piece_from_peer(conn, piece_index, piece_size, nullptr, v2.get(), peer_supports_v2);
+            }
+            else
+            {
+                // 边收边算 SHA-1，最后一个 block 到达时摘要即可用
+                std::string actual_hash;
+                piece_data = download_piece_from_peer(conn, piece_index, piece_size, &actual_hash);
+
+                // 5) 校验 piece hash
+                if (!hashes.matches(static_cast<size_t>(piece_index), reinterpret_cast<const uint8_t*>(actual_hash.data())))
+                {
+                    throw std::runtime_error("Piece hash mismatch");
+                }
             }
 
             // 6) 写入文件
@@ -2113,7 +3211,7 @@ int main(int argc, char* argv[])
         //   ./your_program download -o /tmp/test.txt sample.torrent
         //
         // 执行流程（并发下载版，work queue + 多 peer worker）：
-        //   1) 读取并解析 torrent：拿到 announce(tracker_url)、length(total_length)、piece length(piece_length)、pieces(pieces_blob)
+        //   1) 读取并解析 torrent：拿到 announce(tracker_url)、length(total_length)、piece length(piece_length)、pieces(hashes)
         //   2) 计算 info_hash：对 info 字典原始 bencode 做 SHA1（20 字节二进制）
         //   3) 请求 tracker：GET tracker_url?info_hash=...&peer_id=...&left=...&compact=1
         //   4) 解析 peers：tracker 返回 compact peers（每 6 字节一个 peer），得到 "ip:port" 列表
@@ -2129,9 +3227,12 @@ int main(int argc, char* argv[])
         //      - 循环领取任务：从 PieceWorkQueue 里找一个该 peer 拥有且尚未下载的 piece_index
         //      - 下载 piece：
         //          * 把 piece 切成 16KiB blocks
-        //          * 对每个 block 发送 request(id=6, payload=index+begin+length)
-        //          * 收到 piece(id=7, payload=index+begin+block) 后写入 piece_buffer 对应区间
-        //      - 校验 piece：对 piece_buffer 做 SHA1，必须等于 pieces_blob 中对应的 20 字节哈希
+        //          * 对每个 block 发送 request(id=6, payload=index+begin+length)，最多 pipeline depth 个同时在途，
+        //            当前 piece 的 block 都已请求时提前领取下一个 piece 继续请求
+        //          * 收到 piece(id=7, payload=index+begin+block) 后按 (index, begin) 匹配 request，写入 piece_buffer 对应区间
+        //      - 交给校验线程池（PieceVerifier，有界队列），网络线程立即领取下一个 piece
+        //      - 校验 piece：接收时增量算出的 SHA1 由校验线程与 PieceHashTable 中对应的 20 字节摘要比较
+        //        （v2/hybrid torrent 在接收时按 SHA-256 merkle 树逐 block 校验，坏 block 单独重新请求）
         //      - 写入共享缓冲区：把 piece_buffer memcpy 到 file_data[piece_offset : piece_offset+piece_size]
         //      - 标记完成：PieceWorkQueue 把该 piece 标记为 done，remaining--
         //   7) 所有 pieces 完成后：把 file_data 一次性写入 -o 指定的输出文件
@@ -2152,18 +3253,26 @@ int main(int argc, char* argv[])
 
         // 读取并解析 torrent
         std::string file_content = read_file(torrent_file);
-        json torrent = decode_bencoded_value(file_content);
-
-        std::string tracker_url = torrent["announce"].get<std::string>();
-        int64_t total_length = torrent["info"]["length"].get<int64_t>();
-        int64_t piece_length = torrent["info"]["piece length"].get<int64_t>();
-        std::string pieces_blob = torrent["info"]["pieces"].get<std::string>();
+        TorrentMeta torrent = TorrentMeta::parse(file_content);
+        const InfoDict& info = torrent.info;
+
+        std::string tracker_url(torrent.tracker_url());
+        int64_t piece_length = info.piece_length;
+
+        // 单文件 v2/hybrid torrent 按 SHA-256 merkle 树逐 block 校验（多文件 hybrid 按 v1 校验）；
+        // 纯 v2 没有 length/pieces
+        std::unique_ptr<V2PieceLayer> v2 = load_v2_piece_layer(torrent);
+        int64_t total_length = v2 ? v2->file_length : info.total_length();
+        PieceHashTable hashes;
+        if (info.has_pieces)
+        {
+            hashes = PieceHashTable(info.pieces);
+        }
 
-        // 计算 info_hash（二进制 20 字节）
-        std::string info_dict = extract_info_dict(file_content);
-        std::string info_hash = SHA1::hash(info_dict);
+        // 计算 info_hash（二进制 20 字节，info 字典的原始字节区间）
+        std::string info_hash = torrent_info_hash(info);
 
-        int64_t num_pieces = static_cast<int64_t>(pieces_blob.size() / 20);
+        int64_t num_pieces = v2 ? v2->num_pieces() : static_cast<int64_t>(hashes.size());
         if (num_pieces <= 0)
         {
             throw std::runtime_error("Invalid pieces field");
@@ -2183,11 +3292,7 @@ int main(int argc, char* argv[])
         url << "&left=" << total_length;
         url << "&compact=" << 1;
 
-        std::string tracker_resp_raw = http_get(url.str());
-        json tracker_resp = decode_bencoded_value(tracker_resp_raw);
-
-        std::string peers_data = tracker_resp["peers"].get<std::string>();
-        std::vector<std::string> peers = parse_peers(peers_data);
+        std::vector<std::string> peers = announce_to_tracker(url.str()).peers;
         if (peers.empty())
         {
             throw std::runtime_error("No peers returned by tracker");
@@ -2203,6 +3308,10 @@ int main(int argc, char* argv[])
 
         PieceWorkQueue queue(num_pieces);
 
+        // piece 校验线程池：网络 worker 收数据并增量算 SHA-1，比较摘要与写缓冲区在这里完成
+        const size_t verify_threads = std::max(1u, std::thread::hardware_concurrency());
+        PieceVerifier verifier(queue, hashes, file_data, verify_threads, verify_threads * 2);
+
         // 分批启动 worker：每个 worker 使用一个 peer 连接
         const size_t max_workers = 4;
         size_t next_peer = 0;
@@ -2221,7 +3330,8 @@ int main(int argc, char* argv[])
                 threads.emplace_back([&, peer_addr]() {
                     try
                     {
-                        download_worker(peer_addr, info_hash, my_peer_id, total_length, piece_length, pieces_blob, &queue, &file_data);
+                        download_worker(peer_addr, info_hash, my_peer_id, total_length, piece_length, num_pieces, &queue, &verifier,
+                                        v2.get());
                     }
                     catch (const std::exception& e)
                     {
@@ -2244,6 +3354,9 @@ int main(int argc, char* argv[])
             next_peer += batch;
         }
 
+        // 等校验线程处理完已提交的 piece
+        verifier.close();
+
         if (queue.remaining.load() > 0)
         {
             throw std::runtime_error(last_error.empty() ? "Download incomplete" : last_error);
@@ -2329,13 +3442,8 @@ int main(int argc, char* argv[])
         url << "&left=" << 999;  // 必须大于 0 才能获取 peers
         url << "&compact=" << 1;
         
-        // 发送 tracker 请求
-        std::string response = http_get(url.str());
-        json tracker_response = decode_bencoded_value(response);
-        
-        // 解析 peers
-        std::string peers_data = tracker_response["peers"].get<std::string>();
-        std::vector<std::string> peers = parse_peers(peers_data);
+        // 发送 tracker 请求并解析 peers
+        std::vector<std::string> peers = announce_to_tracker(url.str()).peers;
         
         if (peers.empty())
         {
@@ -2350,24 +3458,26 @@ int main(int argc, char* argv[])
         
         // 建立 TCP 连接
         SOCKET sock = tcp_connect(peer_host, peer_port);
+        PeerConnection conn(sock);
         
         // 执行握手（支持扩展协议）
         bool peer_supports_extensions = false;
-        std::string received_peer_id = perform_handshake(sock, info_hash, my_peer_id, true, &peer_supports_extensions);
+        std::string received_peer_id = perform_handshake(conn, info_hash, my_peer_id, true, &peer_supports_extensions);
         
         // 接收 bitfield 消息
-        (void)recv_bitfield_payload(sock);
+        (void)recv_bitfield_payload(conn);
         
         // 如果对方支持扩展，发送扩展握手
         if (peer_supports_extensions)
         {
-            send_extension_handshake(sock);
+            send_extension_handshake(conn);
             
             // 接收对方的扩展握手消息
-            json peer_ext_handshake = recv_extension_handshake(sock);
+            BencodeArena arena;
+            const BencodeValue& peer_ext_handshake = recv_extension_handshake(conn, arena);
             
             // 提取对方的 ut_metadata ID
-            int peer_metadata_id = peer_ext_handshake["m"]["ut_metadata"].get<int>();
+            int peer_metadata_id = static_cast<int>(peer_ext_handshake["m"]["ut_metadata"].as_int());
             
             // 输出对方的 peer id 和 metadata extension ID
             std::cout << "Peer ID: " << to_hex(received_peer_id) << std::endl;
@@ -2418,13 +3528,8 @@ int main(int argc, char* argv[])
         url << "&left=" << 999;
         url << "&compact=" << 1;
         
-        // 发送 tracker 请求
-        std::string response = http_get(url.str());
-        json tracker_response = decode_bencoded_value(response);
-        
-        // 解析 peers
-        std::string peers_data = tracker_response["peers"].get<std::string>();
-        std::vector<std::string> peers = parse_peers(peers_data);
+        // 发送 tracker 请求并解析 peers
+        std::vector<std::string> peers = announce_to_tracker(url.str()).peers;
         
         if (peers.empty())
         {
@@ -2439,13 +3544,14 @@ int main(int argc, char* argv[])
         
         // 建立 TCP 连接
         SOCKET sock = tcp_connect(peer_host, peer_port);
+        PeerConnection conn(sock);
         
         // 执行基础握手（支持扩展协议）
         bool peer_supports_extensions = false;
-        (void)perform_handshake(sock, info_hash, my_peer_id, true, &peer_supports_extensions);
+        (void)perform_handshake(conn, info_hash, my_peer_id, true, &peer_supports_extensions);
         
         // 接收 bitfield 消息
-        (void)recv_bitfield_payload(sock);
+        (void)recv_bitfield_payload(conn);
         
         if (!peer_supports_extensions)
         {
@@ -2454,17 +3560,18 @@ int main(int argc, char* argv[])
         }
         
         // 发送扩展握手
-        send_extension_handshake(sock);
+        send_extension_handshake(conn);
         
         // 接收对方的扩展握手
-        json peer_ext_handshake = recv_extension_handshake(sock);
-        int peer_metadata_id = peer_ext_handshake["m"]["ut_metadata"].get<int>();
+        BencodeArena arena;
+        const BencodeValue& peer_ext_handshake = recv_extension_handshake(conn, arena);
+        int peer_metadata_id = static_cast<int>(peer_ext_handshake["m"]["ut_metadata"].as_int());
         
         // 发送元数据请求 (msg_type=0, piece=0)
-        send_metadata_request(sock, peer_metadata_id, 0);
+        send_metadata_request(conn, peer_metadata_id, 0);
         
         // 接收元数据数据消息
-        std::string metadata = recv_metadata_data(sock);
+        std::string metadata = recv_metadata_data(conn);
         
         closesocket(sock);
         
@@ -2476,22 +3583,21 @@ int main(int argc, char* argv[])
         }
         
         // 解析 metadata（这是 info 字典的 bencode 编码）
-        json info = decode_bencoded_value(metadata);
-        
-        // 输出 torrent 信息
-        std::cout << "Tracker URL: " << tracker_url << std::endl;
-        std::cout << "Length: " << info["length"].get<int64_t>() << std::endl;
-        std::cout << "Info Hash: " << info_hash_hex << std::endl;
-        std::cout << "Piece Length: " << info["piece length"].get<int64_t>() << std::endl;
-        std::cout << "Piece Hashes:" << std::endl;
+        InfoDict info = InfoDict::parse(metadata);
+        
+        // 输出 torrent 信息（拼进一个缓冲区，一次写出）
+        std::string_view pieces = info.pieces;
+        std::string out;
+        out.reserve(256 + pieces.size() / 20 * 41);
+        out += "Tracker URL: " + tracker_url + "\n";
+        out += "Length: " + std::to_string(info.total_length()) + "\n";
+        out += "Info Hash: " + info_hash_hex + "\n";
+        out += "Piece Length: " + std::to_string(info.piece_length) + "\n";
+        out += "Piece Hashes:\n";
         
         // 输出每个 piece 的哈希值
-        std::string pieces = info["pieces"].get<std::string>();
-        for (size_t i = 0; i < pieces.size(); i += 20)
-        {
-            std::string piece_hash = pieces.substr(i, 20);
-            std::cout << to_hex(piece_hash) << std::endl;
-        }
+        append_piece_hashes(out, pieces);
+        write_stdout(out);
     }
     else if (command == "magnet_download_piece")
     {
@@ -2547,13 +3653,8 @@ int main(int argc, char* argv[])
         url << "&left=" << 999;
         url << "&compact=" << 1;
         
-        // 发送 tracker 请求
-        std::string response = http_get(url.str());
-        json tracker_response = decode_bencoded_value(response);
-        
-        // 解析 peers
-        std::string peers_data = tracker_response["peers"].get<std::string>();
-        std::vector<std::string> peers = parse_peers(peers_data);
+        // 发送 tracker 请求并解析 peers
+        std::vector<std::string> peers = announce_to_tracker(url.str()).peers;
         
         if (peers.empty())
         {
@@ -2571,13 +3672,14 @@ int main(int argc, char* argv[])
         {
             // 3. 建立 TCP 连接
             sock = tcp_connect(peer_host, peer_port);
+            PeerConnection conn(sock);
             
             // 执行基础握手（支持扩展协议）
             bool peer_supports_extensions = false;
-            (void)perform_handshake(sock, info_hash, my_peer_id, true, &peer_supports_extensions);
+            (void)perform_handshake(conn, info_hash, my_peer_id, true, &peer_supports_extensions);
             
             // 接收 bitfield 消息
-            (void)recv_bitfield_payload(sock);
+            (void)recv_bitfield_payload(conn);
             
             if (!peer_supports_extensions)
             {
@@ -2585,15 +3687,16 @@ int main(int argc, char* argv[])
             }
             
             // 4. 发送扩展握手
-            send_extension_handshake(sock);
+            send_extension_handshake(conn);
             
             // 接收对方的扩展握手
-            json peer_ext_handshake = recv_extension_handshake(sock);
-            int peer_metadata_id = peer_ext_handshake["m"]["ut_metadata"].get<int>();
+            BencodeArena arena;
+            const BencodeValue& peer_ext_handshake = recv_extension_handshake(conn, arena);
+            int peer_metadata_id = static_cast<int>(peer_ext_handshake["m"]["ut_metadata"].as_int());
             
             // 5. 获取 info 字典（使用 metadata 扩展）
-            send_metadata_request(sock, peer_metadata_id, 0);
-            std::string metadata = recv_metadata_data(sock);
+            send_metadata_request(conn, peer_metadata_id, 0);
+            std::string metadata = recv_metadata_data(conn);
             
             // 验证 info hash
             std::string computed_hash = SHA1::hash(metadata);
@@ -2603,15 +3706,15 @@ int main(int argc, char* argv[])
             }
             
             // 解析 metadata（这是 info 字典的 bencode 编码）
-            json info = decode_bencoded_value(metadata);
+            InfoDict info = InfoDict::parse(metadata);
             
             // 提取 torrent 信息
-            int64_t total_length = info["length"].get<int64_t>();
-            int64_t piece_length = info["piece length"].get<int64_t>();
-            std::string pieces_blob = info["pieces"].get<std::string>();
+            int64_t total_length = info.total_length();
+            int64_t piece_length = info.piece_length;
+            PieceHashTable hashes(info.pieces);
             
             // piece 边界检查 + 计算本 piece 实际长度
-            int64_t num_pieces = static_cast<int64_t>(pieces_blob.size() / 20);
+            int64_t num_pieces = static_cast<int64_t>(hashes.size());
             if (piece_index >= num_pieces)
             {
                 throw std::runtime_error("piece_index out of range");
@@ -2624,20 +3727,19 @@ int main(int argc, char* argv[])
             }
             
             int64_t piece_size = std::min(piece_length, total_length - piece_offset);
-            std::string expected_piece_hash = pieces_blob.substr(static_cast<size_t>(piece_index) * 20, 20);
             
             // 6. 发送 interested 消息
-            send_peer_message(sock, 2, "");
+            conn.queue_message(2);
             
             // 等待 unchoke
-            wait_for_unchoke(sock);
+            wait_for_unchoke(conn);
             
-            // 下载 piece 数据（按 16KiB block 分段请求）
-            std::string piece_data = download_piece_from_peer(sock, piece_index, piece_size);
+            // 下载 piece 数据（按 16KiB block 分段、流水线请求）
+            std::string actual_hash;
+            std::string piece_data = download_piece_from_peer(conn, piece_index, piece_size, &actual_hash);
             
-            // 校验 piece hash
-            std::string actual_hash = SHA1::hash(piece_data);
-            if (actual_hash != expected_piece_hash)
+            // 校验 piece hash（摘要在接收过程中已增量算好）
+            if (!hashes.matches(static_cast<size_t>(piece_index), reinterpret_cast<const uint8_t*>(actual_hash.data())))
             {
                 throw std::runtime_error("Piece hash mismatch");
             }
@@ -2709,13 +3811,8 @@ int main(int argc, char* argv[])
         url << "&left=" << 999;
         url << "&compact=" << 1;
         
-        // 发送 tracker 请求
-        std::string response = http_get(url.str());
-        json tracker_response = decode_bencoded_value(response);
-        
-        // 解析 peers
-        std::string peers_data = tracker_response["peers"].get<std::string>();
-        std::vector<std::string> peers = parse_peers(peers_data);
+        // 发送 tracker 请求并解析 peers
+        std::vector<std::string> peers = announce_to_tracker(url.str()).peers;
         
         if (peers.empty())
         {
@@ -2729,22 +3826,22 @@ int main(int argc, char* argv[])
         parse_host_port(peer_addr, peer_host, peer_port);
         
         SOCKET metadata_sock = INVALID_SOCKET;
-        json info;
         int64_t total_length = 0;
         int64_t piece_length = 0;
-        std::string pieces_blob;
+        PieceHashTable hashes;
         
         try
         {
             // 建立连接获取 metadata
             metadata_sock = tcp_connect(peer_host, peer_port);
+            PeerConnection metadata_conn(metadata_sock);
             
             // 执行基础握手（支持扩展协议）
             bool peer_supports_extensions = false;
-            (void)perform_handshake(metadata_sock, info_hash, my_peer_id, true, &peer_supports_extensions);
+            (void)perform_handshake(metadata_conn, info_hash, my_peer_id, true, &peer_supports_extensions);
             
             // 接收 bitfield 消息
-            (void)recv_bitfield_payload(metadata_sock);
+            (void)recv_bitfield_payload(metadata_conn);
             
             if (!peer_supports_extensions)
             {
@@ -2752,15 +3849,16 @@ int main(int argc, char* argv[])
             }
             
             // 发送扩展握手
-            send_extension_handshake(metadata_sock);
+            send_extension_handshake(metadata_conn);
             
             // 接收对方的扩展握手
-            json peer_ext_handshake = recv_extension_handshake(metadata_sock);
-            int peer_metadata_id = peer_ext_handshake["m"]["ut_metadata"].get<int>();
+            BencodeArena arena;
+            const BencodeValue& peer_ext_handshake = recv_extension_handshake(metadata_conn, arena);
+            int peer_metadata_id = static_cast<int>(peer_ext_handshake["m"]["ut_metadata"].as_int());
             
             // 获取 info 字典（使用 metadata 扩展）
-            send_metadata_request(metadata_sock, peer_metadata_id, 0);
-            std::string metadata = recv_metadata_data(metadata_sock);
+            send_metadata_request(metadata_conn, peer_metadata_id, 0);
+            std::string metadata = recv_metadata_data(metadata_conn);
             
             closesocket(metadata_sock);
             metadata_sock = INVALID_SOCKET;
@@ -2773,12 +3871,12 @@ int main(int argc, char* argv[])
             }
             
             // 解析 metadata（这是 info 字典的 bencode 编码）
-            info = decode_bencoded_value(metadata);
+            InfoDict info = InfoDict::parse(metadata);
             
             // 提取 torrent 信息
-            total_length = info["length"].get<int64_t>();
-            piece_length = info["piece length"].get<int64_t>();
-            pieces_blob = info["pieces"].get<std::string>();
+            total_length = info.total_length();
+            piece_length = info.piece_length;
+            hashes = PieceHashTable(info.pieces);
         }
         catch (...)
         {
@@ -2790,7 +3888,7 @@ int main(int argc, char* argv[])
         }
         
         // 4. 并发下载所有 pieces
-        int64_t num_pieces = static_cast<int64_t>(pieces_blob.size() / 20);
+        int64_t num_pieces = static_cast<int64_t>(hashes.size());
         if (num_pieces <= 0)
         {
             throw std::runtime_error("Invalid pieces field");
@@ -2806,6 +3904,10 @@ int main(int argc, char* argv[])
         
         PieceWorkQueue queue(num_pieces);
         
+        // piece 校验线程池：网络 worker 收数据并增量算 SHA-1，比较摘要与写缓冲区在这里完成
+        const size_t verify_threads = std::max(1u, std::thread::hardware_concurrency());
+        PieceVerifier verifier(queue, hashes, file_data, verify_threads, verify_threads * 2);
+        
         // 分批启动 worker：每个 worker 使用一个 peer 连接
         const size_t max_workers = 4;
         size_t next_peer = 0;
@@ -2824,7 +3926,7 @@ int main(int argc, char* argv[])
                 threads.emplace_back([&, worker_peer_addr]() {
                     try
                     {
-                        download_worker(worker_peer_addr, info_hash, my_peer_id, total_length, piece_length, pieces_blob, &queue, &file_data);
+                        download_worker(worker_peer_addr, info_hash, my_peer_id, total_length, piece_length, num_pieces, &queue, &verifier);
                     }
                     catch (const std::exception& e)
                     {
@@ -2847,6 +3949,9 @@ int main(int argc, char* argv[])
             next_peer += batch;
         }
         
+        // 等校验线程处理完已提交的 piece
+        verifier.close();
+        
         if (queue.remaining.load() > 0)
         {
             throw std::runtime_error(last_error.empty() ? "Download incomplete" : last_error);
@@ -2865,6 +3970,194 @@ int main(int argc, char* argv[])
         }
         out.close();
     } 
+    else if (command == "recheck")
+    {
+        // ================================================================
+        // 处理 "recheck" 命令 - 校验本地已有文件中哪些 piece 是完好的
+        // ================================================================
+        // 用法:
+        //   ./your_program recheck <torrent_file> <path> [-o <bitfield_output>]
+        //
+        // 不联网：mmap 本地文件，所有核心并行对每个 piece 做 SHA-1，
+        // 与 torrent 中 pieces 字段比对。多文件 torrent 的 path 为根目录（见 LocalPayload）。输出有效 piece 数、十六进制 bitfield
+        // 与校验吞吐量；指定 -o 时把原始 bitfield 字节写入文件。
+
+        if (argc < 4)
+        {
+            std::cerr << "Usage: " << argv[0] << " recheck <torrent_file> <path> [-o <bitfield_output>]" << std::endl;
+            return 1;
+        }
+
+        std::string torrent_file = argv[2];
+        std::string payload_path = argv[3];
+        std::string bitfield_path;
+        if (argc >= 6 && std::string(argv[4]) == "-o")
+        {
+            bitfield_path = argv[5];
+        }
+
+        std::string file_content = read_file(torrent_file);
+        TorrentMeta torrent = TorrentMeta::parse(file_content);
+        const InfoDict& info = torrent.info;
+
+        int64_t total_length = info.total_length();
+        int64_t piece_length = info.piece_length;
+        PieceHashTable hashes(info.pieces);
+        if (piece_length <= 0 || total_length < 0)
+        {
+            throw std::runtime_error("Invalid torrent lengths");
+        }
+
+        LocalPayload payload = LocalPayload::open(info, payload_path);
+
+        auto start = std::chrono::steady_clock::now();
+        const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<uint8_t> valid = recheck_pieces(payload, total_length, piece_length, hashes, threads);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        size_t valid_count = static_cast<size_t>(std::count(valid.begin(), valid.end(), 1));
+        int64_t hashed_bytes = payload.available_bytes();
+        std::string bitfield = pack_bitfield(valid);
+
+        std::cout << "Pieces: " << valid.size() << std::endl;
+        std::cout << "Valid: " << valid_count << std::endl;
+        std::cout << "Invalid: " << valid.size() - valid_count << std::endl;
+        std::cout << "Bitfield: " << to_hex(bitfield) << std::endl;
+        std::cout << "Throughput: " << std::fixed << std::setprecision(2)
+                  << (seconds > 0 ? static_cast<double>(hashed_bytes) / seconds / 1e9 : 0.0) << " GB/s ("
+                  << hashed_bytes << " bytes in " << std::setprecision(3) << seconds << " s, "
+                  << threads << " threads)" << std::endl;
+
+        if (!bitfield_path.empty())
+        {
+            std::ofstream out(bitfield_path, std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                throw std::runtime_error("Failed to open output file: " + bitfield_path);
+            }
+            out.write(bitfield.data(), static_cast<std::streamsize>(bitfield.size()));
+        }
+    }
+    else if (command == "create")
+    {
+        // ================================================================
+        // 处理 "create" 命令 - 由本地文件或目录制作 .torrent 文件
+        // ================================================================
+        // 用法:
+        //   ./your_program create -o <torrent_file> [-a <announce_url>] [-l <piece_length>] <path>
+        //
+        // - path 为文件时生成单文件 torrent（info.length），
+        //   为目录时生成多文件 torrent（info.files，路径按字典序）
+        // - 不指定 -l 或 -l auto 时自动选择 piece 长度
+        // - 不指定 -a 时生成没有 tracker 的 torrent：info / recheck 照常可用，
+        //   需要联系 tracker 的命令（peers、download 等）会报错
+        // - 读取与 SHA-1 分别由多个线程组成流水线（见 hash_payload_pieces）
+
+        std::string output_path;
+        std::string announce;
+        std::string piece_length_arg = "auto";
+        std::string input_path;
+
+        for (int i = 2; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if ((arg == "-o" || arg == "-a" || arg == "-l") && i + 1 < argc)
+            {
+                std::string value = argv[++i];
+                if (arg == "-o") output_path = value;
+                else if (arg == "-a") announce = value;
+                else piece_length_arg = value;
+            }
+            else
+            {
+                input_path = arg;
+            }
+        }
+
+        if (output_path.empty() || input_path.empty())
+        {
+            std::cerr << "Usage: " << argv[0] << " create -o <torrent_file> [-a <announce_url>] [-l <piece_length>] <path>" << std::endl;
+            return 1;
+        }
+
+        std::filesystem::path root = std::filesystem::path(input_path).lexically_normal();
+        if (!root.has_filename()) root = root.parent_path();
+
+        std::vector<CreateFileEntry> files = collect_create_files(root);
+        int64_t total_length = 0;
+        for (auto& f : files)
+        {
+            f.offset = total_length;
+            total_length += f.length;
+        }
+        if (total_length <= 0)
+        {
+            throw std::runtime_error("Cannot create torrent for empty payload");
+        }
+
+        int64_t piece_length = piece_length_arg == "auto" ? auto_piece_length(total_length) : std::stoll(piece_length_arg);
+        if (piece_length <= 0 || piece_length % (16 * 1024) != 0)
+        {
+            throw std::runtime_error("Piece length must be a positive multiple of 16 KiB");
+        }
+
+        const size_t hw = std::max(1u, std::thread::hardware_concurrency());
+        const size_t readers = std::clamp<size_t>(hw / 2, 2, 4);
+
+        auto start = std::chrono::steady_clock::now();
+        std::string pieces = hash_payload_pieces(files, total_length, piece_length, readers, hw);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        json info = json::object();
+        info["name"] = root.filename().string();
+        info["piece length"] = piece_length;
+        info["pieces"] = pieces;
+        if (std::filesystem::is_regular_file(root))
+        {
+            info["length"] = total_length;
+        }
+        else
+        {
+            json file_list = json::array();
+            for (const auto& f : files)
+            {
+                json entry = json::object();
+                entry["length"] = f.length;
+                entry["path"] = f.path;
+                file_list.push_back(entry);
+            }
+            info["files"] = file_list;
+        }
+
+        json torrent = json::object();
+        if (!announce.empty()) torrent["announce"] = announce;
+        torrent["created by"] = "codecrafters-bittorrent";
+        torrent["creation date"] = static_cast<int64_t>(std::time(nullptr));
+        torrent["info"] = info;
+
+        std::string encoded = bencode_encode(torrent);
+        std::ofstream out(output_path, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            throw std::runtime_error("Failed to open output file: " + output_path);
+        }
+        out.write(encoded.data(), static_cast<std::streamsize>(encoded.size()));
+        if (!out)
+        {
+            throw std::runtime_error("Failed to write output file");
+        }
+        out.close();
+
+        // info hash 取刚写出的编码中 info 字典的原始区间，不再单独编码一次
+        std::cout << "Info Hash: " << to_hex(torrent_info_hash(TorrentMeta::parse(encoded).info)) << std::endl;
+        std::cout << "Files: " << files.size() << std::endl;
+        std::cout << "Length: " << total_length << std::endl;
+        std::cout << "Piece Length: " << piece_length << std::endl;
+        std::cout << "Pieces: " << pieces.size() / 20 << std::endl;
+        std::cout << "Throughput: " << std::fixed << std::setprecision(2)
+                  << (seconds > 0 ? static_cast<double>(total_length) / seconds / 1e9 : 0.0) << " GB/s ("
+                  << readers << " readers, " << hw << " hashers)" << std::endl;
+    }
     else 
     {
         // 未知命令，输出错误信息
@@ -2874,3 +4167,18 @@ int main(int argc, char* argv[])
 
     return 0;  // 程序正常退出
 }
+
+int main(int argc, char* argv[])
+{
+    // 各命令的错误（torrent 格式错误、网络失败等）都以异常报告：
+    // 输出一行错误信息并以非零状态退出，而不是 terminate
+    try
+    {
+        return run_command(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
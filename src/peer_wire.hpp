@@ -0,0 +1,29 @@
+/**
+ * @file peer_wire.hpp
+ * @brief peer wire 协议的大端整数读写
+ *
+ * 消息长度前缀、request / piece / hash request 中的字段都是 4 字节大端整数。
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+inline uint32_t read_u32_be(std::string_view buf, size_t offset)
+{
+    return (static_cast<uint32_t>(static_cast<unsigned char>(buf[offset])) << 24) |
+           (static_cast<uint32_t>(static_cast<unsigned char>(buf[offset + 1])) << 16) |
+           (static_cast<uint32_t>(static_cast<unsigned char>(buf[offset + 2])) << 8) |
+           (static_cast<uint32_t>(static_cast<unsigned char>(buf[offset + 3])));
+}
+
+inline void append_u32_be(std::string& out, uint32_t value)
+{
+    out.push_back(static_cast<char>((value >> 24) & 0xFF));
+    out.push_back(static_cast<char>((value >> 16) & 0xFF));
+    out.push_back(static_cast<char>((value >> 8) & 0xFF));
+    out.push_back(static_cast<char>(value & 0xFF));
+}
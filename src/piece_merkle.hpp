@@ -0,0 +1,350 @@
+/**
+ * @file piece_merkle.hpp
+ * @brief BitTorrent v2（BEP 52）piece 的逐 block merkle 校验
+ *
+ * V2PieceLayer 是单文件 v2/hybrid torrent 的 piece 哈希层；PieceMerkleVerifier 用 hash request
+ * 向 peer 要一个 piece 覆盖的叶子（16 KiB block）哈希，验证后逐 block 比较，
+ * 拿不到可信叶子哈希时退化为整 piece 校验。load_v2_piece_layer 从 TorrentMeta 的 file tree 与
+ * piece layers 中取出这一层。
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "sha256.hpp"
+#include "bencode.hpp"
+#include "torrent.hpp"
+#include "peer_wire.hpp"
+
+/**
+ * @brief 单文件 v2/hybrid torrent 的 piece 哈希层（download 命令用）
+ */
+struct V2PieceLayer
+{
+    static constexpr int64_t block_size = 16 * 1024;
+
+    std::string pieces_root;
+    int64_t file_length = 0;
+    int64_t piece_length = 0;
+    std::string layer; // 每个 piece 32 字节；文件不超过一个 piece 时为空
+
+    int64_t num_pieces() const
+    {
+        return (file_length + piece_length - 1) / piece_length;
+    }
+
+    /**
+     * @brief piece 子树的根：piece layers 中的条目，单 piece 文件就是 pieces root
+     */
+    std::string piece_hash(int piece_index) const
+    {
+        if (layer.empty()) return pieces_root;
+        return layer.substr(static_cast<size_t>(piece_index) * 32, 32);
+    }
+
+    /**
+     * @brief piece 子树的叶子数（含补齐的全 0 叶子）
+     */
+    size_t leaves_per_piece() const
+    {
+        if (layer.empty())
+        {
+            return merkle_pow2_ceil(static_cast<size_t>((file_length + block_size - 1) / block_size));
+        }
+        return static_cast<size_t>(piece_length / block_size);
+    }
+};
+
+/**
+ * @brief 一个 piece 的逐 block merkle 校验
+ *
+ * 开始下载时发 hash request（id=21）请求本 piece 的叶子哈希，回复（hashes id=22 /
+ * reject id=23）与 block 一样在下载循环里异步处理。BEP 52 规定一个请求最多 512 个哈希，
+ * 超过 512 个叶子（piece 大于 8 MiB）时按 512 个一组分别请求，每组附带从该组子树根
+ * 到 piece 子树根的 proof（uncle）哈希，各组独立验证。
+ *
+ * 拿到可信叶子哈希的 block 由 verify_block() 逐个比较，之前已到达的 block 由 on_hashes()
+ * 补查；peer 不支持 v2 或拒绝请求时，相应 block 退化为 verify_piece()：
+ * 由收到的 block 哈希算出子树根，整 piece 比较。
+ */
+struct PieceMerkleVerifier
+{
+    static constexpr size_t max_request_hashes = 512;
+
+    PieceMerkleVerifier(const V2PieceLayer& v2, int piece_index, int64_t piece_size, bool peer_supports_v2)
+        : layer(v2),
+          index(piece_index),
+          request_hashes(peer_supports_v2),
+          expected(v2.leaves_per_piece()),
+          actual(static_cast<size_t>((piece_size + V2PieceLayer::block_size - 1) / V2PieceLayer::block_size))
+    {
+        // 只有一个叶子：piece 哈希本身就是它
+        if (expected.size() == 1)
+        {
+            expected[0] = layer.piece_hash(index);
+            request_hashes = false;
+        }
+    }
+
+    /**
+     * @brief 需要向 peer 请求叶子哈希时返回各 hash request 的 payload，否则返回空
+     *
+     * payload: pieces root(32) + base layer(4) + index(4) + length(4) + proof layers(4)
+     */
+    std::vector<std::string> leaf_hash_requests()
+    {
+        if (!request_hashes) return {};
+        request_hashes = false;
+
+        size_t leaf_count = expected.size();
+        size_t chunk = std::min(leaf_count, max_request_hashes);
+        uint32_t proof_layers = 0;
+        while ((chunk << proof_layers) < leaf_count) proof_layers++;
+
+        // 只覆盖补齐叶子（文件末尾之后）的组不用请求
+        for (size_t first = 0; first < actual.size(); first += chunk)
+        {
+            std::string request;
+            request.reserve(48);
+            request += layer.pieces_root;
+            append_u32_be(request, 0); // base layer = 叶子层
+            append_u32_be(request, static_cast<uint32_t>(static_cast<size_t>(index) * leaf_count + first));
+            append_u32_be(request, static_cast<uint32_t>(chunk));
+            append_u32_be(request, proof_layers);
+            requests.push_back(std::move(request));
+        }
+        return requests;
+    }
+
+    bool hashes_pending() const { return !requests.empty(); }
+
+    /**
+     * @brief 放弃未回复的 hash request（对方迟迟不回复）：这些叶子改为整 piece 校验，之后的回复忽略
+     */
+    void abandon_hash_requests() { requests.clear(); }
+
+    /**
+     * @brief 处理 hashes / reject 消息
+     *
+     * 回复的头部与请求相同；被拒绝或哈希与 piece layer 不符时，这一组叶子改为整 piece 校验。
+     *
+     * @param bad 输出：已收到但与叶子哈希不符的 block 序号（需要重新请求）
+     * @return 不是本 piece 的回复时返回 false
+     */
+    bool on_hashes(uint8_t id, std::string_view payload, std::vector<size_t>& bad)
+    {
+        if (payload.size() < 48) return false;
+        auto it = std::find_if(requests.begin(), requests.end(),
+                               [&](const std::string& r) { return payload.compare(0, 48, r) == 0; });
+        if (it == requests.end()) return false;
+        std::string request = std::move(*it);
+        requests.erase(it);
+        if (id == 23) return true;
+
+        size_t leaf_count = expected.size();
+        size_t first = read_u32_be(request, 36) - static_cast<size_t>(index) * leaf_count;
+        size_t chunk = read_u32_be(request, 40);
+        size_t proof_layers = read_u32_be(request, 44);
+        if (payload.size() != 48 + (chunk + proof_layers) * 32)
+        {
+            throw std::runtime_error("Invalid hashes message length");
+        }
+
+        std::vector<std::string> hashes;
+        hashes.reserve(chunk);
+        for (size_t i = 0; i < chunk; i++) hashes.emplace_back(payload.substr(48 + i * 32, 32));
+
+        // 组的子树根沿 proof 哈希向上，应得到 piece layers 中的 piece 哈希
+        std::string node = merkle_root(hashes, chunk);
+        size_t position = first / chunk;
+        SHA256 sha256;
+        for (size_t k = 0; k < proof_layers; k++, position >>= 1)
+        {
+            const uint8_t* uncle = reinterpret_cast<const uint8_t*>(payload.data() + 48 + (chunk + k) * 32);
+            if (position & 1)
+            {
+                sha256.update(uncle, 32);
+                sha256.update(node);
+            }
+            else
+            {
+                sha256.update(node);
+                sha256.update(uncle, 32);
+            }
+            node = sha256.final();
+        }
+        if (node != layer.piece_hash(index)) return true;
+
+        for (size_t i = 0; i < chunk; i++)
+        {
+            size_t leaf = first + i;
+            expected[leaf] = std::move(hashes[i]);
+            if (leaf < actual.size() && !actual[leaf].empty() && actual[leaf] != expected[leaf])
+            {
+                actual[leaf].clear();
+                bad.push_back(leaf);
+            }
+        }
+        return true;
+    }
+
+    bool verify_block(int64_t begin, const char* data, size_t len)
+    {
+        size_t idx = static_cast<size_t>(begin / V2PieceLayer::block_size);
+        if (idx >= actual.size()) return false;
+
+        actual[idx] = SHA256::hash(reinterpret_cast<const uint8_t*>(data), len);
+        if (expected[idx].empty() || actual[idx] == expected[idx]) return true;
+        actual[idx].clear();
+        return false;
+    }
+
+    bool verify_piece() const
+    {
+        // 每个 block 都已对照可信叶子哈希单独校验过
+        bool all_checked = std::all_of(expected.begin(), expected.begin() + static_cast<std::ptrdiff_t>(actual.size()),
+                                       [](const std::string& h) { return !h.empty(); });
+        if (all_checked) return true;
+        return merkle_root(actual, expected.size()) == layer.piece_hash(index);
+    }
+
+    const V2PieceLayer& layer;
+    int index;
+    bool request_hashes;               // 对方支持 v2 且尚未请求过时才发 hash request
+    int piece_attempts = 0;            // 整 piece 校验失败的次数
+    std::vector<std::string> requests; // 已发出、尚未回复的 hash request payload（用于匹配回复）
+    std::vector<std::string> expected; // 按叶子的可信哈希；为空的叶子只能整 piece 校验
+    std::vector<std::string> actual;   // 已收到 block 的 SHA-256
+};
+
+// ============================================================================
+// file tree / piece layers
+// ============================================================================
+
+/**
+ * @brief v2 file tree 中的一个文件
+ */
+struct V2File
+{
+    std::vector<std::string> path;
+    int64_t length = 0;
+    std::string pieces_root; // 32 字节；空文件没有
+};
+
+/**
+ * @brief 递归展开 file tree，按路径字典序输出所有文件
+ */
+inline void collect_v2_files(const BencodeView& node, std::vector<std::string>& prefix, std::vector<V2File>& out)
+{
+    if (!node.is_dict()) throw std::runtime_error("Invalid file tree");
+
+    for (const auto& entry : node)
+    {
+        BencodeView child = entry.value();
+        if (!child.is_dict()) throw std::runtime_error("Invalid file tree");
+
+        prefix.emplace_back(entry.key);
+        BencodeView leaf = child.find("");
+        if (leaf.is_dict())
+        {
+            V2File file;
+            file.path = prefix;
+            file.length = leaf["length"].as_int();
+            if (file.length > 0)
+            {
+                file.pieces_root = std::string(leaf["pieces root"].as_string());
+                if (file.pieces_root.size() != 32) throw std::runtime_error("Invalid pieces root");
+            }
+            out.push_back(std::move(file));
+        }
+        else
+        {
+            collect_v2_files(child, prefix, out);
+        }
+        prefix.pop_back();
+    }
+}
+
+inline std::vector<V2File> parse_v2_file_tree(const InfoDict& info)
+{
+    std::vector<V2File> files;
+    std::vector<std::string> prefix;
+    collect_v2_files(BencodeView::parse(info.file_tree), prefix, files);
+    return files;
+}
+
+/**
+ * @brief 从 torrent 中取出单文件 v2/hybrid torrent 的 piece 哈希层
+ *
+ * v1 torrent 返回 nullptr；多文件（或只有空文件）的 hybrid torrent 也返回 nullptr，
+ * 按 v1 的 SHA-1 pieces 校验。同时用 piece 层重算 pieces root，
+ * 拒绝 piece layers 与 file tree 不一致的 torrent。
+ *
+ * @throws std::runtime_error 多文件的纯 v2 torrent（不支持）或 v2 字段无效
+ */
+inline std::unique_ptr<V2PieceLayer> load_v2_piece_layer(const TorrentMeta& torrent)
+{
+    const InfoDict& info = torrent.info;
+    if (!info.is_v2()) return nullptr;
+
+    std::vector<V2File> files = parse_v2_file_tree(info);
+    if (files.size() != 1 || files[0].length <= 0)
+    {
+        if (info.has_pieces) return nullptr;
+        if (files.size() != 1)
+        {
+            throw std::runtime_error("Multi-file v2 torrents are not supported (" + std::to_string(files.size()) +
+                                     " files in file tree)");
+        }
+        throw std::runtime_error("v2 torrent has no data to download");
+    }
+
+    auto v2 = std::make_unique<V2PieceLayer>();
+    v2->pieces_root = files[0].pieces_root;
+    v2->file_length = files[0].length;
+    v2->piece_length = info.piece_length;
+    if (v2->piece_length < V2PieceLayer::block_size || (v2->piece_length & (v2->piece_length - 1)) != 0)
+    {
+        throw std::runtime_error("Invalid v2 piece length");
+    }
+
+    if (v2->file_length > v2->piece_length)
+    {
+        // piece layers 以 pieces root 为键，值是整层哈希
+        BencodeView layer;
+        if (!torrent.piece_layers.empty())
+        {
+            layer = BencodeView::parse(torrent.piece_layers).find(v2->pieces_root);
+        }
+        if (!layer.is_string())
+        {
+            throw std::runtime_error("Missing piece layer");
+        }
+        v2->layer = std::string(layer.as_string());
+        if (static_cast<int64_t>(v2->layer.size()) != v2->num_pieces() * 32)
+        {
+            throw std::runtime_error("Invalid piece layer length");
+        }
+
+        std::vector<std::string> hashes;
+        hashes.reserve(static_cast<size_t>(v2->num_pieces()));
+        for (size_t i = 0; i < v2->layer.size(); i += 32) hashes.push_back(v2->layer.substr(i, 32));
+
+        // piece 层往上补齐用的是全 0 叶子子树的根
+        std::string pad = merkle_root({}, v2->leaves_per_piece());
+        if (merkle_root(hashes, merkle_pow2_ceil(hashes.size()), pad) != v2->pieces_root)
+        {
+            throw std::runtime_error("Piece layer does not match pieces root");
+        }
+    }
+
+    return v2;
+}
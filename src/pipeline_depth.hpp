@@ -0,0 +1,88 @@
+/**
+ * @file pipeline_depth.hpp
+ * @brief 每个 peer 连接的 request 流水线深度估计
+ *
+ * 一问一答式地请求 block，每个 peer 的吞吐被限制在每个 RTT 一个 16 KiB block；
+ * 在途 request 数应接近带宽时延积。除了构造时取一次 clock::now() 作为第一个统计窗口的起点，
+ * PipelineDepthEstimator 只使用调用方传入的时间点，可以用模拟时钟单独测试。
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+constexpr size_t default_pipeline_depth = 16; // 还没有测量数据时的初始深度
+constexpr size_t min_pipeline_depth = 4;
+constexpr size_t max_pipeline_depth = 250;    // 对方未声明 reqq 时的上限（常见客户端的默认 reqq）
+
+/**
+ * @brief 每个连接的 request 深度：目标在途数 ≈ 带宽 × RTT / block 大小
+ *
+ * 带宽按 250 ms 的窗口统计后做指数平均。RTT 取连接上见过的最小 request RTT：
+ * 链路跑满后 request 会在 peer 端排队，实测 RTT 随深度一起变大，用平均值会让目标
+ * 一路涨到上限，最小值则接近真实的往返时延。目标取 2 倍带宽时延积：深度不足时
+ * 测得的带宽 ≈ 深度 / RTT，每个窗口目标约翻一倍，直到带宽不再增长；
+ * 慢 peer 的目标随之降到下限，不会囤积 block。
+ */
+class PipelineDepthEstimator
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit PipelineDepthEstimator(size_t initial_depth)
+        : target_(std::clamp(initial_depth, min_pipeline_depth, max_pipeline_depth)),
+          window_start_(clock::now())
+    {
+    }
+
+    /**
+     * @brief 对方在扩展握手中声明的 reqq（不丢弃的最大在途 request 数）
+     */
+    void set_limit(size_t limit)
+    {
+        limit_ = std::clamp(limit, size_t{1}, max_pipeline_depth);
+        target_ = std::min(target_, limit_);
+    }
+
+    size_t target() const { return target_; }
+
+    /**
+     * @param rtt request 发出到对应 block 到达的时间
+     * @param bytes block 长度
+     */
+    void on_block(clock::time_point now, clock::duration rtt, size_t bytes)
+    {
+        min_rtt_ = std::min(min_rtt_, std::chrono::duration<double>(rtt).count());
+
+        window_bytes_ += bytes;
+        double elapsed = std::chrono::duration<double>(now - window_start_).count();
+        if (elapsed >= rate_window)
+        {
+            double rate = static_cast<double>(window_bytes_) / elapsed;
+            bandwidth_ = bandwidth_ > 0 ? bandwidth_ * 0.75 + rate * 0.25 : rate;
+            window_start_ = now;
+            window_bytes_ = 0;
+        }
+        if (bandwidth_ <= 0) return; // 第一个窗口结束前保持初始深度
+
+        double bdp = bandwidth_ * min_rtt_ / static_cast<double>(block_size);
+        size_t target = static_cast<size_t>(std::ceil(2 * bdp));
+        target_ = std::clamp(target, std::min(min_pipeline_depth, limit_), limit_);
+    }
+
+private:
+    static constexpr double rate_window = 0.25;
+    static constexpr size_t block_size = 16 * 1024;
+
+    size_t target_;
+    size_t limit_ = max_pipeline_depth;
+    clock::time_point window_start_;
+    uint64_t window_bytes_ = 0;
+    double bandwidth_ = 0;  // 字节/秒
+    double min_rtt_ = std::numeric_limits<double>::infinity(); // 秒
+};
@@ -0,0 +1,874 @@
+/**
+ * @file sha1.hpp
+ * @brief SHA-1 哈希实现（运行时选择后端）
+ *
+ * SHA-1 (Secure Hash Algorithm 1) 产生 160 位 (20 字节) 的哈希值，
+ * 用于计算 torrent 的 Info Hash 以及校验每个 piece。
+ *
+ * 支持三种后端，首次使用时按 CPU 能力自动选择：
+ *   - ShaNi    : x86 SHA 扩展指令（sha1rnds4 等），单核最快
+ *   - OpenSSL  : OpenSSL EVP 接口（其内部同样有汇编优化）
+ *   - Portable : 纯 C++ 实现，任何平台可用
+ *
+ * 自动选择顺序: ShaNi > OpenSSL > Portable。
+ * 可通过环境变量 BITTORRENT_SHA1_BACKEND=auto|shani|openssl|portable
+ * 或 SHA1::set_backend() 强制指定后端，便于对比吞吐量。
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <stdexcept>
+
+#include <openssl/evp.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA1_HAVE_X86 1
+#else
+#define SHA1_HAVE_X86 0
+#endif
+
+/**
+ * @brief SHA-1 计算后端
+ */
+enum class SHA1Backend
+{
+    Auto,
+    Portable,
+    ShaNi,
+    OpenSSL,
+};
+
+namespace sha1_detail
+{
+
+// ============================================================================
+// Portable 实现
+// ============================================================================
+
+inline uint32_t rol(uint32_t value, uint32_t bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+inline uint32_t blk(const uint32_t* block, uint32_t i)
+{
+    return rol(block[(i + 13) & 15] ^ block[(i + 8) & 15] ^ block[(i + 2) & 15] ^ block[i], 1);
+}
+
+inline void R0(const uint32_t* block, uint32_t v, uint32_t& w, uint32_t x, uint32_t y, uint32_t& z, uint32_t i)
+{
+    z += ((w & (x ^ y)) ^ y) + block[i] + 0x5A827999 + rol(v, 5);
+    w = rol(w, 30);
+}
+
+inline void R1(uint32_t* block, uint32_t v, uint32_t& w, uint32_t x, uint32_t y, uint32_t& z, uint32_t i)
+{
+    block[i] = blk(block, i);
+    z += ((w & (x ^ y)) ^ y) + block[i] + 0x5A827999 + rol(v, 5);
+    w = rol(w, 30);
+}
+
+inline void R2(uint32_t* block, uint32_t v, uint32_t& w, uint32_t x, uint32_t y, uint32_t& z, uint32_t i)
+{
+    block[i] = blk(block, i);
+    z += (w ^ x ^ y) + block[i] + 0x6ED9EBA1 + rol(v, 5);
+    w = rol(w, 30);
+}
+
+inline void R3(uint32_t* block, uint32_t v, uint32_t& w, uint32_t x, uint32_t y, uint32_t& z, uint32_t i)
+{
+    block[i] = blk(block, i);
+    z += (((w | x) & y) | (w & x)) + block[i] + 0x8F1BBCDC + rol(v, 5);
+    w = rol(w, 30);
+}
+
+inline void R4(uint32_t* block, uint32_t v, uint32_t& w, uint32_t x, uint32_t y, uint32_t& z, uint32_t i)
+{
+    block[i] = blk(block, i);
+    z += (w ^ x ^ y) + block[i] + 0xCA62C1D6 + rol(v, 5);
+    w = rol(w, 30);
+}
+
+/**
+ * @brief 压缩若干个连续的 64 字节块（纯 C++）
+ */
+inline void compress_portable(uint32_t state[5], const uint8_t* data, size_t blocks)
+{
+    for (; blocks > 0; blocks--, data += 64)
+    {
+        uint32_t block[16];
+        for (uint32_t i = 0; i < 16; i++)
+            block[i] = (static_cast<uint32_t>(data[i * 4]) << 24) | (static_cast<uint32_t>(data[i * 4 + 1]) << 16) |
+                       (static_cast<uint32_t>(data[i * 4 + 2]) << 8) | static_cast<uint32_t>(data[i * 4 + 3]);
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+        R0(block, a, b, c, d, e, 0);  R0(block, e, a, b, c, d, 1);  R0(block, d, e, a, b, c, 2);  R0(block, c, d, e, a, b, 3);
+        R0(block, b, c, d, e, a, 4);  R0(block, a, b, c, d, e, 5);  R0(block, e, a, b, c, d, 6);  R0(block, d, e, a, b, c, 7);
+        R0(block, c, d, e, a, b, 8);  R0(block, b, c, d, e, a, 9);  R0(block, a, b, c, d, e, 10); R0(block, e, a, b, c, d, 11);
+        R0(block, d, e, a, b, c, 12); R0(block, c, d, e, a, b, 13); R0(block, b, c, d, e, a, 14); R0(block, a, b, c, d, e, 15);
+        R1(block, e, a, b, c, d, 0);  R1(block, d, e, a, b, c, 1);  R1(block, c, d, e, a, b, 2);  R1(block, b, c, d, e, a, 3);
+        R2(block, a, b, c, d, e, 4);  R2(block, e, a, b, c, d, 5);  R2(block, d, e, a, b, c, 6);  R2(block, c, d, e, a, b, 7);
+        R2(block, b, c, d, e, a, 8);  R2(block, a, b, c, d, e, 9);  R2(block, e, a, b, c, d, 10); R2(block, d, e, a, b, c, 11);
+        R2(block, c, d, e, a, b, 12); R2(block, b, c, d, e, a, 13); R2(block, a, b, c, d, e, 14); R2(block, e, a, b, c, d, 15);
+        R2(block, d, e, a, b, c, 0);  R2(block, c, d, e, a, b, 1);  R2(block, b, c, d, e, a, 2);  R2(block, a, b, c, d, e, 3);
+        R2(block, e, a, b, c, d, 4);  R2(block, d, e, a, b, c, 5);  R2(block, c, d, e, a, b, 6);  R2(block, b, c, d, e, a, 7);
+        R3(block, a, b, c, d, e, 8);  R3(block, e, a, b, c, d, 9);  R3(block, d, e, a, b, c, 10); R3(block, c, d, e, a, b, 11);
+        R3(block, b, c, d, e, a, 12); R3(block, a, b, c, d, e, 13); R3(block, e, a, b, c, d, 14); R3(block, d, e, a, b, c, 15);
+        R3(block, c, d, e, a, b, 0);  R3(block, b, c, d, e, a, 1);  R3(block, a, b, c, d, e, 2);  R3(block, e, a, b, c, d, 3);
+        R3(block, d, e, a, b, c, 4);  R3(block, c, d, e, a, b, 5);  R3(block, b, c, d, e, a, 6);  R3(block, a, b, c, d, e, 7);
+        R3(block, e, a, b, c, d, 8);  R3(block, d, e, a, b, c, 9);  R3(block, c, d, e, a, b, 10); R3(block, b, c, d, e, a, 11);
+        R4(block, a, b, c, d, e, 12); R4(block, e, a, b, c, d, 13); R4(block, d, e, a, b, c, 14); R4(block, c, d, e, a, b, 15);
+        R4(block, b, c, d, e, a, 0);  R4(block, a, b, c, d, e, 1);  R4(block, e, a, b, c, d, 2);  R4(block, d, e, a, b, c, 3);
+        R4(block, c, d, e, a, b, 4);  R4(block, b, c, d, e, a, 5);  R4(block, a, b, c, d, e, 6);  R4(block, e, a, b, c, d, 7);
+        R4(block, d, e, a, b, c, 8);  R4(block, c, d, e, a, b, 9);  R4(block, b, c, d, e, a, 10); R4(block, a, b, c, d, e, 11);
+        R4(block, e, a, b, c, d, 12); R4(block, d, e, a, b, c, 13); R4(block, c, d, e, a, b, 14); R4(block, b, c, d, e, a, 15);
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e;
+    }
+}
+
+// ============================================================================
+// SHA-NI 实现（x86 SHA 扩展）
+// ============================================================================
+// 每条 sha1rnds4 完成 4 轮；sha1msg1/sha1msg2 负责消息扩展，
+// sha1nexte 根据上一组的 A 计算下一组的 E。
+// 函数用 target 属性单独开启 SHA 指令，调用前必须确认 CPU 支持。
+
+#if SHA1_HAVE_X86
+
+__attribute__((target("sha,sse4.1,ssse3")))
+inline void compress_shani(uint32_t state[5], const uint8_t* data, size_t blocks)
+{
+    const __m128i MASK = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+    __m128i ABCD = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+    __m128i E0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+    ABCD = _mm_shuffle_epi32(ABCD, 0x1B);
+
+    for (; blocks > 0; blocks--, data += 64)
+    {
+        const __m128i ABCD_SAVE = ABCD;
+        const __m128i E0_SAVE = E0;
+        __m128i E1, MSG0, MSG1, MSG2, MSG3;
+
+        // 轮 0-3
+        MSG0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0)), MASK);
+        E0 = _mm_add_epi32(E0, MSG0);
+        E1 = ABCD;
+        ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+
+        // 轮 4-7
+        MSG1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)), MASK);
+        E1 = _mm_sha1nexte_epu32(E1, MSG1);
+        E0 = ABCD;
+        ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 0);
+        MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+
+        // 轮 8-11
+        MSG2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)), MASK);
+        E0 = _mm_sha1nexte_epu32(E0, MSG2);
+        E1 = ABCD;
+        ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+        MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+        MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+        // 轮 12-15
+        MSG3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)), MASK);
+        E1 = _mm_sha1nexte_epu32(E1, MSG3);
+        E0 = ABCD;
+        MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+        ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 0);
+        MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+        MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+        // 轮 16-67：每 4 轮的消息调度模式相同，只是寄存器轮换
+#define SHA1_NI_STEP(EA, EB, M0, M1, M2, M3, FUNC)          \
+        EA = _mm_sha1nexte_epu32(EA, M0);                   \
+        EB = ABCD;                                          \
+        M1 = _mm_sha1msg2_epu32(M1, M0);                    \
+        ABCD = _mm_sha1rnds4_epu32(ABCD, EA, FUNC);         \
+        M3 = _mm_sha1msg1_epu32(M3, M0);                    \
+        M2 = _mm_xor_si128(M2, M0)
+
+        SHA1_NI_STEP(E0, E1, MSG0, MSG1, MSG2, MSG3, 0);   // 16-19
+        SHA1_NI_STEP(E1, E0, MSG1, MSG2, MSG3, MSG0, 1);   // 20-23
+        SHA1_NI_STEP(E0, E1, MSG2, MSG3, MSG0, MSG1, 1);   // 24-27
+        SHA1_NI_STEP(E1, E0, MSG3, MSG0, MSG1, MSG2, 1);   // 28-31
+        SHA1_NI_STEP(E0, E1, MSG0, MSG1, MSG2, MSG3, 1);   // 32-35
+        SHA1_NI_STEP(E1, E0, MSG1, MSG2, MSG3, MSG0, 1);   // 36-39
+        SHA1_NI_STEP(E0, E1, MSG2, MSG3, MSG0, MSG1, 2);   // 40-43
+        SHA1_NI_STEP(E1, E0, MSG3, MSG0, MSG1, MSG2, 2);   // 44-47
+        SHA1_NI_STEP(E0, E1, MSG0, MSG1, MSG2, MSG3, 2);   // 48-51
+        SHA1_NI_STEP(E1, E0, MSG1, MSG2, MSG3, MSG0, 2);   // 52-55
+        SHA1_NI_STEP(E0, E1, MSG2, MSG3, MSG0, MSG1, 2);   // 56-59
+        SHA1_NI_STEP(E1, E0, MSG3, MSG0, MSG1, MSG2, 3);   // 60-63
+        SHA1_NI_STEP(E0, E1, MSG0, MSG1, MSG2, MSG3, 3);   // 64-67
+#undef SHA1_NI_STEP
+
+        // 轮 68-71
+        E1 = _mm_sha1nexte_epu32(E1, MSG1);
+        E0 = ABCD;
+        MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+        ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+        MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+        // 轮 72-75
+        E0 = _mm_sha1nexte_epu32(E0, MSG2);
+        E1 = ABCD;
+        MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+        ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 3);
+
+        // 轮 76-79
+        E1 = _mm_sha1nexte_epu32(E1, MSG3);
+        E0 = ABCD;
+        ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+
+        // 累加到状态
+        E0 = _mm_sha1nexte_epu32(E0, E0_SAVE);
+        ABCD = _mm_add_epi32(ABCD, ABCD_SAVE);
+    }
+
+    ABCD = _mm_shuffle_epi32(ABCD, 0x1B);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), ABCD);
+    state[4] = static_cast<uint32_t>(_mm_extract_epi32(E0, 3));
+}
+
+#endif // SHA1_HAVE_X86
+
+// ============================================================================
+// CPU 能力检测与后端选择
+// ============================================================================
+
+inline bool cpu_has_sha_ni()
+{
+#if SHA1_HAVE_X86
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+    bool sha = ((ebx >> 29) & 1u) != 0;
+    return sha && __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3");
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief 解析后端名称（不区分大小写的常见写法）
+ */
+inline SHA1Backend parse_backend_name(const std::string& name)
+{
+    std::string n;
+    for (char c : name)
+    {
+        if (c == '-' || c == '_') continue;
+        n.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+    }
+
+    if (n.empty() || n == "auto") return SHA1Backend::Auto;
+    if (n == "portable" || n == "generic") return SHA1Backend::Portable;
+    if (n == "shani" || n == "sha") return SHA1Backend::ShaNi;
+    if (n == "openssl" || n == "evp") return SHA1Backend::OpenSSL;
+    throw std::runtime_error("Unknown SHA-1 backend: " + name);
+}
+
+inline std::atomic<int>& selected_backend()
+{
+    // -1 表示尚未解析（首次使用时读取环境变量）
+    static std::atomic<int> backend{-1};
+    return backend;
+}
+
+} // namespace sha1_detail
+
+/**
+ * @brief SHA-1 哈希计算类
+ *
+ * 接口与后端无关：update() 追加数据，final() 输出 20 字节摘要并重置。
+ * Portable 与 ShaNi 共用同一套块缓冲逻辑，只是压缩函数不同；
+ * OpenSSL 后端直接转发给 EVP_MD_CTX。
+ */
+class SHA1
+{
+public:
+    SHA1() : SHA1(active_backend()) {}
+
+    explicit SHA1(SHA1Backend backend)
+    {
+        if (backend == SHA1Backend::Auto) backend = active_backend();
+        if (!backend_available(backend))
+        {
+            throw std::runtime_error(std::string("SHA-1 backend not available: ") + backend_name(backend));
+        }
+        backend_ = backend;
+
+        if (backend_ == SHA1Backend::OpenSSL)
+        {
+            ctx_ = EVP_MD_CTX_new();
+            if (ctx_ == nullptr) throw std::runtime_error("EVP_MD_CTX_new failed");
+        }
+        reset();
+    }
+
+    ~SHA1()
+    {
+        if (ctx_ != nullptr) EVP_MD_CTX_free(ctx_);
+    }
+
+    SHA1(const SHA1&) = delete;
+    SHA1& operator=(const SHA1&) = delete;
+
+    /**
+     * @brief 更新哈希计算，添加更多数据
+     * @param data 要添加的数据
+     * @param len 数据长度
+     */
+    void update(const uint8_t* data, size_t len)
+    {
+        if (ctx_ != nullptr)
+        {
+            if (EVP_DigestUpdate(ctx_, data, len) != 1) throw std::runtime_error("EVP_DigestUpdate failed");
+            return;
+        }
+
+        size_t index = static_cast<size_t>(total_ & 63);
+        total_ += len;
+
+        // 先补齐缓冲区中残留的不完整块
+        if (index != 0)
+        {
+            size_t part = std::min(len, 64 - index);
+            std::memcpy(&buffer_[index], data, part);
+            data += part;
+            len -= part;
+            if (index + part < 64) return;
+            compress(buffer_, 1);
+        }
+
+        // 整块直接从输入压缩，避免拷贝
+        size_t blocks = len / 64;
+        if (blocks > 0)
+        {
+            compress(data, blocks);
+            data += blocks * 64;
+            len -= blocks * 64;
+        }
+
+        if (len > 0) std::memcpy(buffer_, data, len);
+    }
+
+    void update(const std::string& s)
+    {
+        update(reinterpret_cast<const uint8_t*>(s.data()), s.size());
+    }
+
+    /**
+     * @brief 完成哈希计算并返回结果
+     * @return 20 字节的 SHA-1 哈希值
+     */
+    std::string final()
+    {
+        std::string hash(20, '\0');
+        final(reinterpret_cast<uint8_t*>(&hash[0]));
+        return hash;
+    }
+
+    /**
+     * @brief 完成哈希计算，把 20 字节摘要写入 out（无堆分配）
+     */
+    void final(uint8_t out[20])
+    {
+        if (ctx_ != nullptr)
+        {
+            unsigned int out_len = 0;
+            if (EVP_DigestFinal_ex(ctx_, out, &out_len) != 1 || out_len != 20)
+            {
+                throw std::runtime_error("EVP_DigestFinal_ex failed");
+            }
+            reset();
+            return;
+        }
+
+        uint64_t bit_count = total_ * 8;
+        size_t index = static_cast<size_t>(total_ & 63);
+
+        // 填充: 0x80 + 若干 0x00，使长度 ≡ 56 (mod 64)，最后 8 字节为大端位长度
+        buffer_[index++] = 0x80;
+        if (index > 56)
+        {
+            std::memset(&buffer_[index], 0, 64 - index);
+            compress(buffer_, 1);
+            index = 0;
+        }
+        std::memset(&buffer_[index], 0, 56 - index);
+        for (int i = 0; i < 8; i++)
+        {
+            buffer_[56 + i] = static_cast<uint8_t>(bit_count >> ((7 - i) * 8));
+        }
+        compress(buffer_, 1);
+
+        for (uint32_t i = 0; i < 20; i++)
+        {
+            out[i] = static_cast<uint8_t>((state_[i >> 2] >> ((3 - (i & 3)) * 8)) & 255);
+        }
+
+        reset();
+    }
+
+    /**
+     * @brief 便捷函数：计算字符串的 SHA-1 哈希
+     * @param s 输入字符串
+     * @return 20 字节的 SHA-1 哈希值
+     */
+    static std::string hash(const std::string& s)
+    {
+        SHA1 sha1;
+        sha1.update(s);
+        return sha1.final();
+    }
+
+    /**
+     * @brief 本对象实际使用的后端
+     */
+    SHA1Backend backend() const { return backend_; }
+
+    /**
+     * @brief 当前默认后端（新建的 SHA1 对象使用它）
+     *
+     * 首次调用时解析环境变量 BITTORRENT_SHA1_BACKEND，未设置则自动选择。
+     */
+    static SHA1Backend active_backend()
+    {
+        auto& selected = sha1_detail::selected_backend();
+        int value = selected.load(std::memory_order_acquire);
+        if (value < 0)
+        {
+            SHA1Backend requested = SHA1Backend::Auto;
+            if (const char* env = std::getenv("BITTORRENT_SHA1_BACKEND"))
+            {
+                requested = sha1_detail::parse_backend_name(env);
+            }
+            set_backend(requested);
+            value = selected.load(std::memory_order_acquire);
+        }
+        return static_cast<SHA1Backend>(value);
+    }
+
+    /**
+     * @brief 强制指定默认后端（Auto 表示按 CPU 能力自动选择）
+     * @throws std::runtime_error 指定的后端在本机不可用
+     */
+    static void set_backend(SHA1Backend backend)
+    {
+        if (backend == SHA1Backend::Auto)
+        {
+            if (backend_available(SHA1Backend::ShaNi)) backend = SHA1Backend::ShaNi;
+            else if (backend_available(SHA1Backend::OpenSSL)) backend = SHA1Backend::OpenSSL;
+            else backend = SHA1Backend::Portable;
+        }
+        else if (!backend_available(backend))
+        {
+            throw std::runtime_error(std::string("SHA-1 backend not available: ") + backend_name(backend));
+        }
+        sha1_detail::selected_backend().store(static_cast<int>(backend), std::memory_order_release);
+    }
+
+    static bool backend_available(SHA1Backend backend)
+    {
+        switch (backend)
+        {
+        case SHA1Backend::Auto:
+        case SHA1Backend::Portable:
+            return true;
+        case SHA1Backend::ShaNi:
+        {
+            static const bool has_sha_ni = sha1_detail::cpu_has_sha_ni();
+            return has_sha_ni;
+        }
+        case SHA1Backend::OpenSSL:
+            return EVP_sha1() != nullptr;
+        }
+        return false;
+    }
+
+    static const char* backend_name(SHA1Backend backend)
+    {
+        switch (backend)
+        {
+        case SHA1Backend::Auto: return "auto";
+        case SHA1Backend::Portable: return "portable";
+        case SHA1Backend::ShaNi: return "shani";
+        case SHA1Backend::OpenSSL: return "openssl";
+        }
+        return "unknown";
+    }
+
+private:
+    SHA1Backend backend_ = SHA1Backend::Portable;
+    EVP_MD_CTX* ctx_ = nullptr;
+    uint32_t state_[5];
+    uint64_t total_ = 0;   // 已输入的字节数
+    uint8_t buffer_[64];
+
+    void reset()
+    {
+        if (ctx_ != nullptr)
+        {
+            if (EVP_DigestInit_ex(ctx_, EVP_sha1(), nullptr) != 1) throw std::runtime_error("EVP_DigestInit_ex failed");
+            return;
+        }
+
+        state_[0] = 0x67452301;
+        state_[1] = 0xEFCDAB89;
+        state_[2] = 0x98BADCFE;
+        state_[3] = 0x10325476;
+        state_[4] = 0xC3D2E1F0;
+        total_ = 0;
+    }
+
+    void compress(const uint8_t* data, size_t blocks)
+    {
+#if SHA1_HAVE_X86
+        if (backend_ == SHA1Backend::ShaNi)
+        {
+            sha1_detail::compress_shani(state_, data, blocks);
+            return;
+        }
+#endif
+        sha1_detail::compress_portable(state_, data, blocks);
+    }
+};
+
+// ============================================================================
+// 多缓冲区批量 SHA-1（SIMD lanes）
+// ============================================================================
+// 单个 SHA-1 的 80 轮是严格串行的，无法在一条消息内部向量化；
+// 但多个互不相关的 piece 可以放进 SIMD 寄存器的不同 lane 同步计算：
+//   - SSE2    : 4 lanes  (128 位)
+//   - AVX2    : 8 lanes  (256 位)
+//   - AVX-512 : 16 lanes (512 位)
+// 要求同一批的缓冲区长度相同（piece 校验天然满足，只有最后一个 piece 例外）。
+//
+// 通道数首次使用时自动选择，可通过环境变量 BITTORRENT_SHA1_LANES=auto|1|4|8|16
+// 或 sha1_set_batch_lanes() 强制指定；1 表示逐个用 SHA1 当前后端计算。
+
+namespace sha1_detail
+{
+
+#if SHA1_HAVE_X86
+
+typedef uint32_t mb_v4 __attribute__((vector_size(16)));
+typedef uint32_t mb_v8 __attribute__((vector_size(32)));
+typedef uint32_t mb_v16 __attribute__((vector_size(64)));
+
+/**
+ * @brief 对 LANES 个缓冲区各压缩一个 64 字节块
+ *
+ * @param st 状态向量 st[0..4]，第 l 个 lane 保存第 l 条消息的 A..E
+ * @param ptrs 每个 lane 的数据指针（各自指向本块起始位置）
+ */
+template <typename V, int LANES>
+__attribute__((always_inline)) inline void mb_compress_block(V* st, const uint8_t* const* ptrs)
+{
+    // 转置载入：w[t] 的第 l 个元素 = 第 l 条消息的第 t 个大端字
+    alignas(64) uint32_t words[16][LANES];
+    for (int l = 0; l < LANES; l++)
+    {
+        const uint8_t* p = ptrs[l];
+        for (int t = 0; t < 16; t++)
+        {
+            uint32_t x;
+            std::memcpy(&x, p + t * 4, 4);
+            words[t][l] = __builtin_bswap32(x);
+        }
+    }
+
+    V w[16];
+    std::memcpy(w, words, sizeof(w));
+
+    V a = st[0], b = st[1], c = st[2], d = st[3], e = st[4];
+
+#define SHA1_MB_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define SHA1_MB_ROUND(i, F, K)                                                              \
+    {                                                                                       \
+        if ((i) >= 16)                                                                      \
+        {                                                                                   \
+            V x = w[((i) + 13) & 15] ^ w[((i) + 8) & 15] ^ w[((i) + 2) & 15] ^ w[(i) & 15]; \
+            w[(i) & 15] = SHA1_MB_ROTL(x, 1);                                               \
+        }                                                                                   \
+        V temp = SHA1_MB_ROTL(a, 5) + (F) + e + (K) + w[(i) & 15];                          \
+        e = d;                                                                              \
+        d = c;                                                                              \
+        c = SHA1_MB_ROTL(b, 30);                                                            \
+        b = a;                                                                              \
+        a = temp;                                                                           \
+    }
+
+    const V k0 = V{} + 0x5A827999u;
+    const V k1 = V{} + 0x6ED9EBA1u;
+    const V k2 = V{} + 0x8F1BBCDCu;
+    const V k3 = V{} + 0xCA62C1D6u;
+
+#pragma GCC unroll 20
+    for (int i = 0; i < 20; i++) SHA1_MB_ROUND(i, ((b & (c ^ d)) ^ d), k0)
+#pragma GCC unroll 20
+    for (int i = 20; i < 40; i++) SHA1_MB_ROUND(i, (b ^ c ^ d), k1)
+#pragma GCC unroll 20
+    for (int i = 40; i < 60; i++) SHA1_MB_ROUND(i, ((b & c) | (d & (b | c))), k2)
+#pragma GCC unroll 20
+    for (int i = 60; i < 80; i++) SHA1_MB_ROUND(i, (b ^ c ^ d), k3)
+
+#undef SHA1_MB_ROUND
+#undef SHA1_MB_ROTL
+
+    st[0] += a; st[1] += b; st[2] += c; st[3] += d; st[4] += e;
+}
+
+/**
+ * @brief LANES 条等长消息的完整 SHA-1（含填充）
+ */
+template <typename V, int LANES>
+__attribute__((always_inline)) inline void mb_hash(const uint8_t* const* inputs, size_t len, uint8_t (*digests)[20])
+{
+    V st[5];
+    st[0] = V{} + 0x67452301u;
+    st[1] = V{} + 0xEFCDAB89u;
+    st[2] = V{} + 0x98BADCFEu;
+    st[3] = V{} + 0x10325476u;
+    st[4] = V{} + 0xC3D2E1F0u;
+
+    const uint8_t* ptrs[LANES];
+    size_t full_blocks = len / 64;
+    for (size_t blk = 0; blk < full_blocks; blk++)
+    {
+        for (int l = 0; l < LANES; l++) ptrs[l] = inputs[l] + blk * 64;
+        mb_compress_block<V, LANES>(st, ptrs);
+    }
+
+    // 尾部 + 填充：长度相同，所以每个 lane 需要的填充块数也相同（1 或 2 块）
+    size_t rest = len % 64;
+    size_t tail_blocks = (rest + 9 > 64) ? 2 : 1;
+    uint64_t bit_count = static_cast<uint64_t>(len) * 8;
+
+    alignas(64) uint8_t tail[LANES][128];
+    for (int l = 0; l < LANES; l++)
+    {
+        uint8_t* t = tail[l];
+        std::memset(t, 0, tail_blocks * 64);
+        if (rest > 0) std::memcpy(t, inputs[l] + full_blocks * 64, rest);
+        t[rest] = 0x80;
+        for (int i = 0; i < 8; i++)
+        {
+            t[tail_blocks * 64 - 8 + i] = static_cast<uint8_t>(bit_count >> ((7 - i) * 8));
+        }
+    }
+    for (size_t blk = 0; blk < tail_blocks; blk++)
+    {
+        for (int l = 0; l < LANES; l++) ptrs[l] = tail[l] + blk * 64;
+        mb_compress_block<V, LANES>(st, ptrs);
+    }
+
+    alignas(64) uint32_t out[5][LANES];
+    std::memcpy(out, st, sizeof(out));
+    for (int l = 0; l < LANES; l++)
+    {
+        for (int i = 0; i < 5; i++)
+        {
+            uint32_t v = out[i][l];
+            digests[l][i * 4 + 0] = static_cast<uint8_t>(v >> 24);
+            digests[l][i * 4 + 1] = static_cast<uint8_t>(v >> 16);
+            digests[l][i * 4 + 2] = static_cast<uint8_t>(v >> 8);
+            digests[l][i * 4 + 3] = static_cast<uint8_t>(v);
+        }
+    }
+}
+
+inline void mb_hash_x4(const uint8_t* const* inputs, size_t len, uint8_t (*digests)[20])
+{
+    mb_hash<mb_v4, 4>(inputs, len, digests);
+}
+
+__attribute__((target("avx2")))
+inline void mb_hash_x8(const uint8_t* const* inputs, size_t len, uint8_t (*digests)[20])
+{
+    mb_hash<mb_v8, 8>(inputs, len, digests);
+}
+
+__attribute__((target("avx512f")))
+inline void mb_hash_x16(const uint8_t* const* inputs, size_t len, uint8_t (*digests)[20])
+{
+    mb_hash<mb_v16, 16>(inputs, len, digests);
+}
+
+#endif // SHA1_HAVE_X86
+
+/**
+ * @brief 本机支持的最大 lane 数
+ */
+inline int max_batch_lanes()
+{
+#if SHA1_HAVE_X86
+    if (__builtin_cpu_supports("avx512f")) return 16;
+    if (__builtin_cpu_supports("avx2")) return 8;
+    return 4;
+#else
+    return 1;
+#endif
+}
+
+inline std::atomic<int>& selected_lanes()
+{
+    // -1 表示尚未解析（首次使用时读取环境变量）
+    static std::atomic<int> lanes{-1};
+    return lanes;
+}
+
+} // namespace sha1_detail
+
+/**
+ * @brief 强制指定批量哈希的 lane 数
+ *
+ * 自动选择时: 有 AVX-512 用 16 lanes；否则若 CPU 有 SHA-NI，单缓冲区的
+ * SHA-NI 已不慢于 8 lanes 的 AVX2，直接逐个计算；再否则取本机最大值。
+ *
+ * @param lanes 0 表示自动选择；1/4/8/16 表示固定值
+ * @throws std::runtime_error 本机不支持该 lane 数
+ */
+inline void sha1_set_batch_lanes(int lanes)
+{
+    if (lanes == 0)
+    {
+        lanes = sha1_detail::max_batch_lanes();
+        if (lanes < 16 && SHA1::backend_available(SHA1Backend::ShaNi)) lanes = 1;
+    }
+    else if (lanes != 1 && lanes != 4 && lanes != 8 && lanes != 16)
+    {
+        throw std::runtime_error("Invalid SHA-1 batch lanes: " + std::to_string(lanes));
+    }
+    else if (lanes > sha1_detail::max_batch_lanes())
+    {
+        throw std::runtime_error("SHA-1 batch lanes not supported on this CPU: " + std::to_string(lanes));
+    }
+    sha1_detail::selected_lanes().store(lanes, std::memory_order_release);
+}
+
+/**
+ * @brief 当前批量哈希使用的 lane 数
+ *
+ * 首次调用时解析环境变量 BITTORRENT_SHA1_LANES，未设置则取本机最大值。
+ */
+inline int sha1_batch_lanes()
+{
+    auto& selected = sha1_detail::selected_lanes();
+    int value = selected.load(std::memory_order_acquire);
+    if (value < 0)
+    {
+        int requested = 0;
+        if (const char* env = std::getenv("BITTORRENT_SHA1_LANES"))
+        {
+            std::string s = env;
+            requested = (s.empty() || s == "auto") ? 0 : std::atoi(s.c_str());
+        }
+        sha1_set_batch_lanes(requested);
+        value = selected.load(std::memory_order_acquire);
+    }
+    return value;
+}
+
+/**
+ * @brief 批量计算 count 个等长缓冲区的 SHA-1
+ *
+ * 按当前 lane 数分组同步计算；凑不满一组的剩余缓冲区依次降级到
+ * 更窄的 lane 宽度（有 SHA-NI 时窄 lane 不划算，直接逐个计算），
+ * 最后不足 4 个时用 SHA1 当前后端逐个计算。
+ *
+ * @param inputs 每个缓冲区的起始指针
+ * @param count 缓冲区个数
+ * @param len 每个缓冲区的长度（全部相同）
+ * @param digests 输出: count 个 20 字节摘要
+ */
+inline void sha1_hash_batch(const uint8_t* const* inputs, size_t count, size_t len, uint8_t (*digests)[20])
+{
+    size_t i = 0;
+
+#if SHA1_HAVE_X86
+    int lanes = sha1_batch_lanes();
+    if (lanes >= 16)
+    {
+        for (; i + 16 <= count; i += 16) sha1_detail::mb_hash_x16(inputs + i, len, digests + i);
+        if (SHA1::active_backend() == SHA1Backend::ShaNi) lanes = 1;
+    }
+    if (lanes >= 8)
+    {
+        for (; i + 8 <= count; i += 8) sha1_detail::mb_hash_x8(inputs + i, len, digests + i);
+    }
+    if (lanes >= 4)
+    {
+        for (; i + 4 <= count; i += 4) sha1_detail::mb_hash_x4(inputs + i, len, digests + i);
+    }
+#endif
+
+    if (i < count)
+    {
+        SHA1 sha1;
+        for (; i < count; i++)
+        {
+            sha1.update(inputs[i], len);
+            sha1.final(digests[i]);
+        }
+    }
+}
+
+/**
+ * @brief 批量计算若干缓冲区的 SHA-1（长度可以不同）
+ *
+ * 相同长度的缓冲区被归为一组走 SIMD 批量路径，
+ * 典型场景下只有最后一个 piece 长度不同。
+ *
+ * @return 与 inputs 一一对应的 20 字节摘要
+ */
+inline std::vector<std::string> sha1_hash_batch(const std::vector<std::string_view>& inputs)
+{
+    std::vector<std::string> results(inputs.size());
+
+    std::vector<size_t> order(inputs.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return inputs[a].size() < inputs[b].size();
+    });
+
+    std::vector<const uint8_t*> ptrs;
+    std::vector<uint8_t> digests;
+    for (size_t start = 0; start < order.size();)
+    {
+        size_t len = inputs[order[start]].size();
+        size_t end = start;
+        while (end < order.size() && inputs[order[end]].size() == len) end++;
+
+        ptrs.clear();
+        for (size_t k = start; k < end; k++)
+        {
+            ptrs.push_back(reinterpret_cast<const uint8_t*>(inputs[order[k]].data()));
+        }
+        digests.resize(ptrs.size() * 20);
+        sha1_hash_batch(ptrs.data(), ptrs.size(), len, reinterpret_cast<uint8_t(*)[20]>(digests.data()));
+
+        for (size_t k = start; k < end; k++)
+        {
+            results[order[k]].assign(reinterpret_cast<const char*>(&digests[(k - start) * 20]), 20);
+        }
+        start = end;
+    }
+
+    return results;
+}
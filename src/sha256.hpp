@@ -0,0 +1,140 @@
+/**
+ * @file sha256.hpp
+ * @brief SHA-256 与 BitTorrent v2 (BEP 52) merkle 树工具
+ *
+ * v2 torrent 把每个文件按 16 KiB block 切分，block 的 SHA-256 作为叶子，
+ * 逐层两两拼接再做 SHA-256，得到文件的 "pieces root"。叶子数不足 2 的幂时，
+ * 用全 0 的 32 字节哈希补齐。"piece layers" 保存的是 piece 长度对应那一层的哈希，
+ * 因此一个 piece 的哈希 = 该 piece 覆盖的 (piece_length / 16 KiB) 个叶子组成的子树根。
+ *
+ * SHA-256 直接使用 OpenSSL EVP 实现（其内部已有 SHA-NI / AVX2 汇编优化）。
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <openssl/evp.h>
+
+/**
+ * @brief SHA-256 哈希计算类（接口与 SHA1 一致）
+ */
+class SHA256
+{
+public:
+    SHA256()
+    {
+        ctx_ = EVP_MD_CTX_new();
+        if (ctx_ == nullptr) throw std::runtime_error("EVP_MD_CTX_new failed");
+        reset();
+    }
+
+    ~SHA256()
+    {
+        EVP_MD_CTX_free(ctx_);
+    }
+
+    SHA256(const SHA256&) = delete;
+    SHA256& operator=(const SHA256&) = delete;
+
+    void update(const uint8_t* data, size_t len)
+    {
+        if (EVP_DigestUpdate(ctx_, data, len) != 1) throw std::runtime_error("EVP_DigestUpdate failed");
+    }
+
+    void update(const std::string& s)
+    {
+        update(reinterpret_cast<const uint8_t*>(s.data()), s.size());
+    }
+
+    /**
+     * @brief 完成哈希计算，把 32 字节摘要写入 out，并重置
+     */
+    void final(uint8_t out[32])
+    {
+        unsigned int out_len = 0;
+        if (EVP_DigestFinal_ex(ctx_, out, &out_len) != 1 || out_len != 32)
+        {
+            throw std::runtime_error("EVP_DigestFinal_ex failed");
+        }
+        reset();
+    }
+
+    std::string final()
+    {
+        std::string hash(32, '\0');
+        final(reinterpret_cast<uint8_t*>(&hash[0]));
+        return hash;
+    }
+
+    static std::string hash(const uint8_t* data, size_t len)
+    {
+        SHA256 sha256;
+        sha256.update(data, len);
+        return sha256.final();
+    }
+
+    static std::string hash(const std::string& s)
+    {
+        return hash(reinterpret_cast<const uint8_t*>(s.data()), s.size());
+    }
+
+private:
+    EVP_MD_CTX* ctx_ = nullptr;
+
+    void reset()
+    {
+        if (EVP_DigestInit_ex(ctx_, EVP_sha256(), nullptr) != 1) throw std::runtime_error("EVP_DigestInit_ex failed");
+    }
+};
+
+// ============================================================================
+// Merkle 树
+// ============================================================================
+
+/**
+ * @brief 不小于 n 的最小 2 的幂（n=0 时返回 1）
+ */
+inline size_t merkle_pow2_ceil(size_t n)
+{
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+/**
+ * @brief 由叶子哈希计算 merkle 根
+ *
+ * @param leaves 叶子哈希（每个 32 字节）
+ * @param leaf_count 树的叶子总数（2 的幂，不小于 leaves.size()）
+ * @param pad 补齐用的哈希，默认全 0；从 piece 层往上算时应为全 0 子树的根
+ * @return 32 字节根哈希
+ */
+inline std::string merkle_root(const std::vector<std::string>& leaves, size_t leaf_count,
+                               const std::string& pad = std::string(32, '\0'))
+{
+    if (leaf_count == 0 || (leaf_count & (leaf_count - 1)) != 0 || leaf_count < leaves.size())
+    {
+        throw std::runtime_error("Invalid merkle leaf count");
+    }
+
+    std::vector<std::string> layer = leaves;
+    layer.resize(leaf_count, pad);
+
+    SHA256 sha256;
+    while (layer.size() > 1)
+    {
+        for (size_t i = 0; i < layer.size() / 2; i++)
+        {
+            sha256.update(layer[2 * i]);
+            sha256.update(layer[2 * i + 1]);
+            layer[i] = sha256.final();
+        }
+        layer.resize(layer.size() / 2);
+    }
+    return layer[0];
+}
@@ -0,0 +1,236 @@
+/**
+ * @file torrent.hpp
+ * @brief .torrent 元信息的强类型解码
+ *
+ * TorrentMeta / InfoDict 先用 BencodeDocument 对输入扫描一遍建立结构索引，再按已知字段名
+ * 在索引上查找（只比较各层字典自己的键，跳过值的内容），直接填入结构体。
+ * 不构建通用 DOM，也不拷贝字符串：所有字符串字段都是指向原始缓冲区的 string_view，
+ * 因此它们不能比 torrent 文件内容（或 metadata）活得更久；索引在解析结束后即释放。
+ *
+ * 覆盖的字段：
+ *   announce / announce-list（BEP 12）/ piece layers（BEP 52）
+ *   info: name / piece length / pieces / length / files / private（BEP 27）/
+ *         meta version / file tree（BEP 52）
+ * v2 的 file tree 与 piece layers 只记录原始区间，需要时再解析。
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+#include "bencode.hpp"
+
+namespace torrent_detail
+{
+
+inline std::runtime_error invalid_field(std::string_view field)
+{
+    return std::runtime_error("Invalid torrent field: " + std::string(field));
+}
+
+inline std::string_view expect_string(const BencodeNode& value, std::string_view field)
+{
+    if (!value.is_string()) throw invalid_field(field);
+    return value.as_string();
+}
+
+inline int64_t expect_int(const BencodeNode& value, std::string_view field)
+{
+    if (!value.is_int()) throw invalid_field(field);
+    return value.as_int();
+}
+
+inline std::vector<std::string_view> expect_string_list(const BencodeNode& value, std::string_view field)
+{
+    if (!value.is_list()) throw invalid_field(field);
+    std::vector<std::string_view> out;
+    for (const auto& entry : value) out.push_back(expect_string(entry.value(), field));
+    return out;
+}
+
+/**
+ * @brief 在字典中查找可选字段；存在时写入 out
+ */
+inline bool find_field(const BencodeNode& dict, std::string_view key, BencodeNode& out)
+{
+    out = dict.find(key);
+    return !out.raw().empty();
+}
+
+} // namespace torrent_detail
+
+/**
+ * @brief 多文件模式（v1）中的一个文件
+ */
+struct TorrentFile
+{
+    int64_t length = 0;
+    std::vector<std::string_view> path;
+};
+
+/**
+ * @brief info 字典
+ */
+struct InfoDict
+{
+    std::string_view raw;           // info 字典的原始编码（计算 info hash）
+    std::string_view name;
+    int64_t piece_length = 0;
+    bool has_pieces = false;        // v1 或 hybrid torrent
+    std::string_view pieces;        // 每 20 字节一个 SHA-1
+    int64_t length = -1;            // 单文件模式的长度；多文件或纯 v2 时为 -1
+    std::vector<TorrentFile> files; // 多文件模式
+    bool is_private = false;
+    int64_t meta_version = 1;
+    std::string_view file_tree;     // v2 file tree 的原始编码；没有时为空
+
+    bool is_v2() const { return meta_version == 2 && !file_tree.empty(); }
+
+    /**
+     * @brief 负载总长度：单文件为 length，多文件为各文件长度之和
+     * @throws std::runtime_error 两者都没有（纯 v2 torrent 的长度在 file tree 中）
+     */
+    int64_t total_length() const
+    {
+        if (length >= 0) return length;
+        if (files.empty()) throw std::runtime_error("Missing torrent field: length");
+        int64_t total = 0;
+        for (const auto& f : files) total += f.length;
+        return total;
+    }
+
+    /**
+     * @brief 解析 info 字典的原始编码（magnet 下载得到的 metadata）
+     */
+    static InfoDict parse(std::string_view raw)
+    {
+        BencodeDocument doc = BencodeDocument::parse(raw);
+        return from_node(doc.root());
+    }
+
+    static InfoDict from_node(const BencodeNode& node)
+    {
+        using namespace torrent_detail;
+        if (!node.is_dict()) throw invalid_field("info");
+
+        InfoDict info;
+        info.raw = node.raw();
+        BencodeNode value;
+        if (find_field(node, "name", value)) info.name = expect_string(value, "name");
+
+        if (!find_field(node, "piece length", value)) throw std::runtime_error("Missing torrent field: piece length");
+        info.piece_length = expect_int(value, "piece length");
+        if (info.piece_length <= 0) throw invalid_field("piece length");
+
+        if (find_field(node, "pieces", value))
+        {
+            info.pieces = expect_string(value, "pieces");
+            info.has_pieces = true;
+            if (info.pieces.size() % 20 != 0) throw invalid_field("pieces");
+        }
+
+        if (find_field(node, "length", value))
+        {
+            info.length = expect_int(value, "length");
+            if (info.length < 0) throw invalid_field("length");
+        }
+
+        if (find_field(node, "files", value))
+        {
+            if (!value.is_list()) throw invalid_field("files");
+            info.files.reserve(value.size());
+            for (const auto& item : value)
+            {
+                BencodeNode file = item.value();
+                if (!file.is_dict()) throw invalid_field("files");
+                TorrentFile f;
+                f.length = expect_int(file["length"], "files.length");
+                if (f.length < 0) throw invalid_field("files.length");
+                f.path = expect_string_list(file["path"], "files.path");
+                info.files.push_back(std::move(f));
+            }
+        }
+
+        if (find_field(node, "private", value)) info.is_private = expect_int(value, "private") == 1;
+        if (find_field(node, "meta version", value)) info.meta_version = expect_int(value, "meta version");
+        if (find_field(node, "file tree", value))
+        {
+            if (!value.is_dict()) throw invalid_field("file tree");
+            info.file_tree = value.raw();
+        }
+
+        if (!info.has_pieces && !info.is_v2()) throw std::runtime_error("Missing torrent field: pieces");
+        return info;
+    }
+};
+
+/**
+ * @brief .torrent 文件的顶层字典
+ */
+struct TorrentMeta
+{
+    std::string_view announce;
+    std::vector<std::vector<std::string_view>> announce_list; // 按 tier 分组
+    std::string_view piece_layers; // v2 piece layers 的原始编码；没有时为空
+    InfoDict info;
+
+    /**
+     * @brief 是否有 tracker（create 不指定 -a 时生成的 torrent 没有）
+     */
+    bool has_tracker() const
+    {
+        if (!announce.empty()) return true;
+        return std::any_of(announce_list.begin(), announce_list.end(), [](const auto& tier) { return !tier.empty(); });
+    }
+
+    /**
+     * @brief 用于 announce 的 tracker：announce，缺省时取 announce-list 的第一个
+     */
+    std::string_view tracker_url() const
+    {
+        if (!announce.empty()) return announce;
+        for (const auto& tier : announce_list)
+        {
+            if (!tier.empty()) return tier.front();
+        }
+        throw std::runtime_error("Missing torrent field: announce");
+    }
+
+    /**
+     * @brief 解析 .torrent 文件内容
+     * @throws std::runtime_error bencode 格式错误、缺少 info / piece length / pieces 或字段类型不符
+     */
+    static TorrentMeta parse(std::string_view content)
+    {
+        using namespace torrent_detail;
+        BencodeDocument doc = BencodeDocument::parse(content);
+        BencodeNode root = doc.root();
+        if (!root.is_dict()) throw std::runtime_error("Torrent file is not a dictionary");
+
+        TorrentMeta meta;
+        BencodeNode value;
+        if (find_field(root, "announce", value)) meta.announce = expect_string(value, "announce");
+        if (find_field(root, "announce-list", value))
+        {
+            if (!value.is_list()) throw invalid_field("announce-list");
+            for (const auto& tier : value)
+            {
+                meta.announce_list.push_back(expect_string_list(tier.value(), "announce-list"));
+            }
+        }
+        if (find_field(root, "piece layers", value))
+        {
+            if (!value.is_dict()) throw invalid_field("piece layers");
+            meta.piece_layers = value.raw();
+        }
+
+        if (!find_field(root, "info", value)) throw std::runtime_error("Missing torrent field: info");
+        meta.info = InfoDict::from_node(value);
+        return meta;
+    }
+};
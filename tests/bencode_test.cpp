@@ -0,0 +1,188 @@
+/**
+ * @file bencode_test.cpp
+ * @brief bencode 解析器的回归检查
+ */
+
+#include <string>
+#include <string_view>
+#include <functional>
+#include <stdexcept>
+#include <cstdint>
+
+#include "bencode.hpp"
+#include "torrent.hpp"
+#include "check.hpp"
+
+namespace
+{
+
+std::string nested_lists(size_t depth)
+{
+    return std::string(depth, 'l') + std::string(depth, 'e');
+}
+
+// ============================================================================
+// 深层嵌套：所有解析入口都必须抛出异常，而不是耗尽调用栈
+// ============================================================================
+
+void test_deep_nesting()
+{
+    const std::string deep = nested_lists(200000);
+    const std::string limit = nested_lists(bencode_detail::max_nesting_depth);
+    const std::string torrent = "d4:infod4:name1:a12:piece lengthi16384e6:pieces20:"
+                                + std::string(20, 'x') + "1:x" + deep + "ee";
+
+    check_throws([&] { (void)decode_bencoded_value(deep); }, "Bencode nesting too deep", "decode_bencoded_value deep");
+    check_throws([&] { (void)BencodeView::parse(deep); }, "Bencode nesting too deep", "BencodeView::parse deep");
+    check_throws([&] { (void)BencodeDocument::parse(deep); }, "Bencode nesting too deep", "BencodeDocument::parse deep");
+    check_throws([&] { (void)TorrentMeta::parse(torrent); }, "Bencode nesting too deep", "TorrentMeta::parse deep");
+    check_throws([&] { (void)InfoDict::parse("d1:x" + deep + "e"); }, "Bencode nesting too deep", "InfoDict::parse deep");
+    check_throws([&] {
+        BencodeArena arena;
+        (void)BencodeValue::parse(deep, arena);
+    }, "Bencode nesting too deep", "BencodeValue::parse deep");
+    check_throws([&] {
+        BencodeHandler handler;
+        BencodeStreamParser parser(handler);
+        parser.feed(deep);
+    }, "Bencode nesting too deep", "BencodeStreamParser deep");
+
+    // 恰好在上限内的嵌套仍然合法
+    check_no_throw([&] { (void)decode_bencoded_value(limit); }, "decode_bencoded_value at limit");
+    check_no_throw([&] { (void)BencodeView::parse(limit); }, "BencodeView::parse at limit");
+    check_no_throw([&] { (void)BencodeDocument::parse(limit); }, "BencodeDocument::parse at limit");
+    check_throws([&] { (void)BencodeDocument::parse(nested_lists(bencode_detail::max_nesting_depth + 1)); },
+                 "Bencode nesting too deep", "BencodeDocument::parse one past limit");
+    check_throws([&] { (void)BencodeView::parse(nested_lists(bencode_detail::max_nesting_depth + 1)); },
+                 "Bencode nesting too deep", "BencodeView::parse one past limit");
+}
+
+// ============================================================================
+// 迭代的 skip_value 与原先的递归实现行为一致
+// ============================================================================
+
+void test_skip_value()
+{
+    const std::string doc = "d1:ad1:bl1:ci1ee1:dlee1:fi-2ee";
+    BencodeView view = BencodeView::parse(doc);
+    check(view.find("a").raw() == "d1:bl1:ci1ee1:dlee", "nested dict raw span");
+    check(view.find("a").find("b").size() == 2, "nested list size");
+    check(view["f"].as_int() == -2, "trailing int after nested dict");
+
+    check_throws([] { (void)BencodeView::parse("d1:ae"); }, "key without value", "dict key without value");
+    check_throws([] { (void)BencodeView::parse("di1ei2ee"); }, "key must be a string", "non-string dict key");
+    check_throws([] { (void)BencodeView::parse("l1:a"); }, "Unterminated", "unterminated list");
+    check_throws([] { (void)BencodeView::parse("lxe"); }, "Invalid bencode value", "invalid byte in list");
+}
+
+// ============================================================================
+// BencodeDocument：查找沿 tape 上的 skip link 跳过兄弟值的子树
+// ============================================================================
+
+void test_document()
+{
+    const std::string input = "d8:announce9:http://x/4:infod5:filesld6:lengthi1e4:pathl1:aeee"
+                              "4:name1:n12:piece lengthi16384e6:pieces0:e1:zi9ee";
+    BencodeDocument doc = BencodeDocument::parse(input);
+    check(doc["announce"].as_string() == "http://x/", "top-level string lookup");
+    check(doc["info"]["piece length"].as_int() == 16384, "lookup past a nested list");
+    check(doc["info"]["files"].size() == 1, "container size from the tape");
+    check(doc["info"]["files"].at(0)["path"].at(0).as_string() == "a", "list indexing");
+    check(doc["z"].as_int() == 9, "lookup past the whole info dict");
+    check(doc["info"].raw() == input.substr(input.find("d5:files"), input.find("1:zi9e") - input.find("d5:files")),
+          "dict raw span");
+    check(!doc.root().contains("missing"), "missing key");
+    check_throws([&] { (void)doc["missing"]; }, "Missing bencode key", "operator[] on missing key");
+
+    size_t keys = 0;
+    for (const auto& entry : doc["info"])
+    {
+        check(!entry.key.empty(), "dict iteration yields keys");
+        keys++;
+    }
+    check(keys == 4, "dict iteration visits every pair");
+
+    check_throws([] { (void)BencodeDocument::parse("d1:ae"); }, "key without value", "document: key without value");
+    check_throws([] { (void)BencodeDocument::parse("di1ei2ee"); }, "key must be a string", "document: non-string key");
+    check_throws([] { (void)BencodeDocument::parse("l1:a"); }, "end of bencode input", "document: unterminated list");
+    check_throws([] { (void)BencodeDocument::parse("i1ei2e"); }, "Trailing data", "document: trailing data");
+}
+
+// ============================================================================
+// 整数只接受规范形式：无前导零，无负零
+// ============================================================================
+
+void test_integers()
+{
+    struct Parser
+    {
+        const char* name;
+        std::function<int64_t(const std::string&)> parse;
+    };
+    const Parser parsers[] = {
+        {"decode_bencoded_value", [](const std::string& in) { return decode_bencoded_value(in).get<int64_t>(); }},
+        {"BencodeView", [](const std::string& in) { return BencodeView::parse(in).as_int(); }},
+        {"BencodeDocument", [](const std::string& in) { return BencodeDocument::parse(in).root().as_int(); }},
+        {"BencodeValue", [](const std::string& in) {
+             BencodeArena arena;
+             return BencodeValue::parse(in, arena).as_int();
+         }},
+        {"BencodeStreamParser", [](const std::string& in) {
+             struct IntHandler : BencodeHandler
+             {
+                 int64_t value = 0;
+                 void on_int(int64_t v) override { value = v; }
+             } handler;
+             BencodeStreamParser parser(handler);
+             parser.feed(in);
+             if (!parser.done()) throw std::runtime_error("Truncated");
+             return handler.value;
+         }},
+    };
+
+    for (const Parser& p : parsers)
+    {
+        const std::string name = p.name;
+        check_no_throw([&] { check(p.parse("i0e") == 0, name + " i0e"); }, name + " i0e");
+        check_no_throw([&] { check(p.parse("i-7e") == -7, name + " i-7e"); }, name + " i-7e");
+        check_no_throw([&] { check(p.parse("i100e") == 100, name + " i100e"); }, name + " i100e");
+        check_no_throw([&] { check(p.parse("i-9223372036854775808e") == INT64_MIN, name + " INT64_MIN"); },
+                       name + " INT64_MIN");
+        for (const char* bad : {"i03e", "i00e", "i-0e", "i-03e", "ie", "i-e", "i1-e", "i9223372036854775808e"})
+        {
+            check_throws([&] { (void)p.parse(bad); }, "integer", name + " rejects " + bad);
+        }
+    }
+}
+
+// ============================================================================
+// 错误信息只报告位置与字节，不包含输入本身
+// ============================================================================
+
+void test_error_message()
+{
+    const std::string input = "l" + std::string(100000, 'x') + "e";
+    check_throws([&] { (void)decode_bencoded_value(input); }, "Unhandled encoded value at offset 1: byte 0x78",
+                 "decode_bencoded_value reports offset and byte");
+    try
+    {
+        (void)decode_bencoded_value(input);
+    }
+    catch (const std::runtime_error& e)
+    {
+        check(std::string_view(e.what()).size() < 100, "error message does not embed the input");
+    }
+}
+
+} // namespace
+
+int main()
+{
+    test_deep_nesting();
+    test_skip_value();
+    test_document();
+    test_integers();
+    test_error_message();
+
+    return check_result("bencode");
+}
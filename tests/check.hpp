@@ -0,0 +1,73 @@
+/**
+ * @file check.hpp
+ * @brief 回归检查的公共部分
+ *
+ * 每个检查失败时打印一行说明；各测试程序最后以 check_result() 作为退出码（ctest 据此判断）。
+ */
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <stdexcept>
+
+namespace check_detail
+{
+
+inline int failures = 0;
+
+inline void check(bool ok, const std::string& what)
+{
+    if (!ok)
+    {
+        std::cerr << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+/**
+ * @brief f 必须抛出 std::runtime_error，且异常信息包含 message
+ */
+inline void check_throws(const std::function<void()>& f, std::string_view message, const std::string& what)
+{
+    try
+    {
+        f();
+    }
+    catch (const std::runtime_error& e)
+    {
+        check(std::string_view(e.what()).find(message) != std::string_view::npos,
+              what + " (got \"" + e.what() + "\")");
+        return;
+    }
+    check(false, what + " (no exception)");
+}
+
+inline void check_no_throw(const std::function<void()>& f, const std::string& what)
+{
+    try
+    {
+        f();
+    }
+    catch (const std::exception& e)
+    {
+        check(false, what + " (threw \"" + e.what() + "\")");
+    }
+}
+
+} // namespace check_detail
+
+using check_detail::check;
+using check_detail::check_throws;
+using check_detail::check_no_throw;
+
+/**
+ * @brief 打印汇总并返回退出码
+ */
+inline int check_result(std::string_view name)
+{
+    if (check_detail::failures == 0) std::cout << "all " << name << " checks passed" << std::endl;
+    return check_detail::failures == 0 ? 0 : 1;
+}
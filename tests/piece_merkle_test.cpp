@@ -0,0 +1,312 @@
+/**
+ * @file piece_merkle_test.cpp
+ * @brief PieceMerkleVerifier 的回归检查（BEP 52 hash request 分组与 proof 校验）
+ *
+ * 用确定性数据构造一个单文件 v2 torrent 的 merkle 树，测试代码扮演 peer 回复 hash request，
+ * 覆盖 8 MiB（恰好 512 个叶子）、16 MiB（需要分两组）以及文件末尾不足一个 piece 的情形。
+ */
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cstdint>
+
+#include "piece_merkle.hpp"
+#include "check.hpp"
+
+namespace
+{
+
+constexpr int64_t block_size = V2PieceLayer::block_size;
+
+/**
+ * @brief 一个文件：数据、叶子哈希与对应的 V2PieceLayer
+ */
+struct TestFile
+{
+    std::string data;
+    std::vector<std::string> leaves; // 按 2 的幂补齐全 0 叶子
+    V2PieceLayer layer;
+
+    TestFile(int64_t piece_length, int64_t file_length)
+    {
+        data.resize(static_cast<size_t>(file_length));
+        uint32_t x = 12345;
+        for (char& c : data)
+        {
+            x = x * 1103515245u + 12345u;
+            c = static_cast<char>(x >> 24);
+        }
+
+        size_t blocks = static_cast<size_t>((file_length + block_size - 1) / block_size);
+        for (size_t i = 0; i < blocks; i++)
+        {
+            size_t begin = i * static_cast<size_t>(block_size);
+            size_t len = std::min(static_cast<size_t>(block_size), data.size() - begin);
+            leaves.push_back(SHA256::hash(reinterpret_cast<const uint8_t*>(data.data() + begin), len));
+        }
+
+        layer.file_length = file_length;
+        layer.piece_length = piece_length;
+        size_t per_piece = static_cast<size_t>(piece_length / block_size);
+        size_t pieces = static_cast<size_t>(layer.num_pieces());
+        leaves.resize(per_piece * pieces, std::string(32, '\0'));
+        for (size_t p = 0; p < pieces; p++) layer.layer += root(p * per_piece, per_piece);
+        layer.pieces_root = std::string(32, 'r'); // 只用作 hash request 中的标识
+    }
+
+    /**
+     * @brief 从 first 开始 count 个叶子的子树根
+     */
+    std::string root(size_t first, size_t count) const
+    {
+        std::vector<std::string> range(leaves.begin() + static_cast<std::ptrdiff_t>(first),
+                                       leaves.begin() + static_cast<std::ptrdiff_t>(first + count));
+        return merkle_root(range, count);
+    }
+
+    /**
+     * @brief 按 BEP 52 回复一个 hash request：请求的叶子哈希，之后是从该组子树根向上的 uncle 哈希
+     */
+    std::string reply(const std::string& request) const
+    {
+        size_t index = read_u32_be(request, 36);
+        size_t length = read_u32_be(request, 40);
+        size_t proof_layers = read_u32_be(request, 44);
+
+        std::string out = request;
+        for (size_t i = 0; i < length; i++) out += leaves[index + i];
+        size_t width = length;
+        size_t position = index / length;
+        for (size_t k = 0; k < proof_layers; k++, width *= 2, position /= 2)
+        {
+            out += root((position ^ 1) * width, width);
+        }
+        return out;
+    }
+
+    std::string_view block(int piece, size_t b) const
+    {
+        size_t begin = static_cast<size_t>(piece) * static_cast<size_t>(layer.piece_length) +
+                       b * static_cast<size_t>(block_size);
+        return std::string_view(data).substr(begin, static_cast<size_t>(block_size));
+    }
+};
+
+int64_t piece_size(const TestFile& file, int piece)
+{
+    return std::min(file.layer.piece_length, file.layer.file_length - piece * file.layer.piece_length);
+}
+
+bool verify(PieceMerkleVerifier& v, const TestFile& file, int piece, size_t b, bool corrupt = false)
+{
+    std::string data(file.block(piece, b));
+    if (corrupt) data[5] ^= 0x5A;
+    return v.verify_block(static_cast<int64_t>(b) * block_size, data.data(), data.size());
+}
+
+void test_request_split(const TestFile& file, size_t expected_requests, uint32_t expected_proof, const std::string& name)
+{
+    PieceMerkleVerifier v(file.layer, 1, piece_size(file, 1), true);
+    std::vector<std::string> requests = v.leaf_hash_requests();
+    check(requests.size() == expected_requests, name + ": request count");
+    size_t leaves = file.layer.leaves_per_piece();
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        const std::string& r = requests[i];
+        size_t length = read_u32_be(r, 40);
+        check(r.size() == 48, name + ": request payload size");
+        check(length <= PieceMerkleVerifier::max_request_hashes, name + ": at most 512 hashes per request");
+        check(read_u32_be(r, 36) == leaves + i * length, name + ": request index");
+        check(read_u32_be(r, 44) == expected_proof, name + ": proof layers");
+    }
+    check(v.leaf_hash_requests().empty(), name + ": requests sent only once");
+}
+
+void test_large_piece()
+{
+    // 16 MiB piece = 1024 个叶子，分两组，各带 1 层 proof
+    TestFile file(16 * 1024 * 1024, 2 * 16 * 1024 * 1024 + 100 * 1024);
+    test_request_split(file, 2, 1, "16 MiB");
+
+    // 全部回复后逐 block 校验：好 block 通过，坏 block 单独被拒绝
+    {
+        PieceMerkleVerifier v(file.layer, 1, piece_size(file, 1), true);
+        std::vector<size_t> bad;
+        for (const std::string& r : v.leaf_hash_requests())
+        {
+            check(v.on_hashes(22, file.reply(r), bad), "16 MiB: reply matched");
+        }
+        check(!v.hashes_pending(), "16 MiB: no hash request pending");
+        check(bad.empty(), "16 MiB: nothing to re-request");
+        check(verify(v, file, 1, 0), "16 MiB: first block verified");
+        check(verify(v, file, 1, 700), "16 MiB: block in second group verified");
+        check(!verify(v, file, 1, 600, true), "16 MiB: corrupt block in second group rejected");
+        check(!verify(v, file, 1, 3, true), "16 MiB: corrupt block in first group rejected");
+        for (size_t b = 0; b < 1024; b++) (void)verify(v, file, 1, b);
+        check(v.verify_piece(), "16 MiB: piece verified block by block");
+    }
+
+    // 回复之前到达的坏 block 在回复到达时被找出
+    {
+        PieceMerkleVerifier v(file.layer, 1, piece_size(file, 1), true);
+        std::vector<std::string> requests = v.leaf_hash_requests();
+        check(verify(v, file, 1, 900, true), "early block accepted before hashes arrive");
+        std::vector<size_t> bad;
+        for (const std::string& r : requests) (void)v.on_hashes(22, file.reply(r), bad);
+        check(bad.size() == 1 && bad[0] == 900, "early corrupt block reported once hashes arrive");
+    }
+
+    // 一组被拒绝：这组的 block 退化为整 piece 校验，另一组仍逐 block 校验
+    {
+        PieceMerkleVerifier v(file.layer, 1, piece_size(file, 1), true);
+        std::vector<std::string> requests = v.leaf_hash_requests();
+        std::vector<size_t> bad;
+        check(v.on_hashes(23, requests[0], bad), "reject matched");
+        check(v.on_hashes(22, file.reply(requests[1]), bad), "second group matched");
+        check(verify(v, file, 1, 10, true), "rejected group: block accepted provisionally");
+        check(!verify(v, file, 1, 600, true), "verified group: corrupt block rejected");
+        for (size_t b = 0; b < 1024; b++) (void)verify(v, file, 1, b, b == 10);
+        check(!v.verify_piece(), "rejected group: corrupt block caught by whole-piece check");
+        (void)verify(v, file, 1, 10);
+        check(v.verify_piece(), "rejected group: whole-piece check passes once repaired");
+    }
+
+    // proof 哈希被篡改：这组叶子不可信，不会据此拒绝好 block
+    {
+        PieceMerkleVerifier v(file.layer, 1, piece_size(file, 1), true);
+        std::vector<std::string> requests = v.leaf_hash_requests();
+        std::vector<size_t> bad;
+        std::string forged = file.reply(requests[0]);
+        forged[48 + 3 * 32] ^= 0x01; // 改一个叶子哈希
+        check(v.on_hashes(22, forged, bad), "forged reply matched");
+        check(v.expected[3].empty(), "forged group not trusted");
+        check(verify(v, file, 1, 3), "good block accepted despite forged hashes");
+    }
+
+    // 对方不回复：放弃 hash request 后整 piece 校验，迟到的回复被忽略
+    {
+        PieceMerkleVerifier v(file.layer, 1, piece_size(file, 1), true);
+        std::vector<std::string> requests = v.leaf_hash_requests();
+        for (size_t b = 0; b < 1024; b++) (void)verify(v, file, 1, b, b == 20);
+        v.abandon_hash_requests();
+        check(!v.hashes_pending(), "abandoned: nothing pending");
+        check(!v.verify_piece(), "abandoned: corrupt block caught by whole-piece check");
+        std::vector<size_t> bad;
+        check(!v.on_hashes(22, file.reply(requests[0]), bad), "abandoned: late reply ignored");
+        (void)verify(v, file, 1, 20);
+        check(v.verify_piece(), "abandoned: whole-piece check passes once repaired");
+    }
+
+    // 文件末尾不足一个 piece：只请求覆盖实际 block 的组
+    {
+        PieceMerkleVerifier v(file.layer, 2, piece_size(file, 2), true);
+        std::vector<std::string> requests = v.leaf_hash_requests();
+        check(requests.size() == 1, "last piece: one request");
+        std::vector<size_t> bad;
+        check(v.on_hashes(22, file.reply(requests[0]), bad), "last piece: reply matched");
+        for (size_t b = 0; b < 7; b++) check(verify(v, file, 2, b), "last piece: block verified");
+        check(v.verify_piece(), "last piece verified");
+    }
+}
+
+void test_512_leaf_piece()
+{
+    // 8 MiB piece = 512 个叶子：一个请求，不需要 proof
+    TestFile file(8 * 1024 * 1024, 3 * 8 * 1024 * 1024);
+    test_request_split(file, 1, 0, "8 MiB");
+
+    PieceMerkleVerifier v(file.layer, 1, piece_size(file, 1), true);
+    std::vector<size_t> bad;
+    for (const std::string& r : v.leaf_hash_requests()) (void)v.on_hashes(22, file.reply(r), bad);
+    check(!verify(v, file, 1, 511, true), "8 MiB: corrupt last block rejected");
+    check(verify(v, file, 1, 511), "8 MiB: good last block verified");
+}
+
+// ============================================================================
+// load_v2_piece_layer：哪些 torrent 逐 block 校验
+// ============================================================================
+
+std::string bstr(const std::string& s)
+{
+    return std::to_string(s.size()) + ":" + s;
+}
+
+std::string v2_file_entry(const std::string& name, int64_t length)
+{
+    return bstr(name) + "d0:d6:lengthi" + std::to_string(length) + "e11:pieces root" + bstr(std::string(32, 'r')) + "ee";
+}
+
+/**
+ * @brief 构造 torrent：files 为 v2 file tree 中的文件；hybrid 时同时带 v1 的 pieces 与 length/files
+ */
+std::string v2_torrent(const std::vector<std::pair<std::string, int64_t>>& files, bool hybrid)
+{
+    std::string tree = "d";
+    for (const auto& f : files) tree += v2_file_entry(f.first, f.second);
+    tree += "e";
+
+    std::string info = "d9:file tree" + tree + "12:meta versioni2e4:name1:t12:piece lengthi16384e";
+    if (hybrid)
+    {
+        if (files.size() == 1)
+        {
+            info += "6:lengthi" + std::to_string(files[0].second) + "e";
+        }
+        else
+        {
+            info += "5:filesl";
+            for (const auto& f : files) info += "d6:lengthi" + std::to_string(f.second) + "e4:pathl" + bstr(f.first) + "ee";
+            info += "e";
+        }
+        info += "6:pieces" + bstr(std::string(20, 'p'));
+    }
+    info += "e";
+    return "d4:info" + info + "e";
+}
+
+void test_load_piece_layer()
+{
+    // TorrentMeta 的字段指向输入，输入须比它活得久
+    const std::string single = v2_torrent({{"a", 100}}, false);
+    std::unique_ptr<V2PieceLayer> layer = load_v2_piece_layer(TorrentMeta::parse(single));
+    check(layer && layer->file_length == 100 && layer->pieces_root == std::string(32, 'r'), "single-file v2 loads");
+
+    const std::string single_hybrid = v2_torrent({{"a", 100}}, true);
+    check(load_v2_piece_layer(TorrentMeta::parse(single_hybrid)) != nullptr, "single-file hybrid verified per block");
+
+    const std::string multi_hybrid = v2_torrent({{"a", 100}, {"b", 200}}, true);
+    check_no_throw([&] {
+        check(load_v2_piece_layer(TorrentMeta::parse(multi_hybrid)) == nullptr, "multi-file hybrid falls back to v1");
+    }, "multi-file hybrid");
+
+    const std::string multi_v2 = v2_torrent({{"a", 100}, {"b", 200}}, false);
+    check_throws([&] { (void)load_v2_piece_layer(TorrentMeta::parse(multi_v2)); },
+                 "Multi-file v2 torrents are not supported (2 files", "multi-file pure v2 rejected");
+
+    const std::string v1 = "d4:infod6:lengthi100e4:name1:t12:piece lengthi16384e6:pieces" + bstr(std::string(20, 'p')) + "ee";
+    check(load_v2_piece_layer(TorrentMeta::parse(v1)) == nullptr, "v1 torrent has no piece layer");
+}
+
+void test_peer_without_v2()
+{
+    TestFile file(16 * 1024 * 1024, 2 * 16 * 1024 * 1024);
+    PieceMerkleVerifier v(file.layer, 0, piece_size(file, 0), false);
+    check(v.leaf_hash_requests().empty(), "no hash request when the peer lacks v2");
+    for (size_t b = 0; b < 1024; b++) (void)verify(v, file, 0, b);
+    check(v.verify_piece(), "whole-piece check without leaf hashes");
+}
+
+} // namespace
+
+int main()
+{
+    test_large_piece();
+    test_512_leaf_piece();
+    test_peer_without_v2();
+    test_load_piece_layer();
+
+    return check_result("piece merkle");
+}
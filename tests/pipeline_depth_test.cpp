@@ -0,0 +1,115 @@
+/**
+ * @file pipeline_depth_test.cpp
+ * @brief PipelineDepthEstimator 的回归检查
+ *
+ * 用模拟时钟驱动一条固定带宽、固定往返时延的链路：在途 request 数取估计器当前的目标，
+ * 深度超过带宽时延积的部分在对端排队，表现为更大的 request RTT。
+ * 检查目标收敛到带宽时延积附近，且遵守 reqq 与上下限。
+ */
+
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <deque>
+
+#include "pipeline_depth.hpp"
+#include "check.hpp"
+
+namespace
+{
+
+using clock = PipelineDepthEstimator::clock;
+constexpr double block_size = 16 * 1024;
+
+clock::duration seconds_of(double seconds)
+{
+    return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+/**
+ * @brief 在链路上模拟 seconds 秒的下载，返回估计器最终的目标深度
+ *
+ * 每个 block 到达时补发 request，使在途数等于当前目标；block 按请求顺序逐个发出，
+ * 到达时间 = max(发出 request 后一个 RTT, 上一个 block 到达后再传一个 block 的时间)。
+ */
+size_t simulate(PipelineDepthEstimator& estimator, double bandwidth, double rtt, double seconds)
+{
+    const clock::time_point start = clock::now();
+    const clock::time_point end = start + seconds_of(seconds);
+    const clock::duration transfer = seconds_of(block_size / bandwidth);
+
+    std::deque<clock::time_point> in_flight; // 在途 request 的发出时间
+    clock::time_point now = start;
+    clock::time_point last_arrival = start;
+    while (now < end)
+    {
+        while (in_flight.size() < estimator.target()) in_flight.push_back(now);
+
+        clock::time_point sent = in_flight.front();
+        in_flight.pop_front();
+        now = std::max(sent + seconds_of(rtt), last_arrival + transfer);
+        last_arrival = now;
+        estimator.on_block(now, now - sent, static_cast<size_t>(block_size));
+    }
+    return estimator.target();
+}
+
+void test_initial_depth()
+{
+    PipelineDepthEstimator estimator(default_pipeline_depth);
+    check(estimator.target() == default_pipeline_depth, "initial target is the configured depth");
+    check(PipelineDepthEstimator(1).target() == min_pipeline_depth, "initial target clamped to minimum");
+    check(PipelineDepthEstimator(100000).target() == max_pipeline_depth, "initial target clamped to maximum");
+}
+
+void test_fast_link_grows()
+{
+    // 8 MB/s × 100 ms：带宽时延积约 49 个 block，目标取 2 倍
+    const double bandwidth = 8e6, rtt = 0.1;
+    const double bdp = bandwidth * rtt / block_size;
+    PipelineDepthEstimator estimator(default_pipeline_depth);
+    size_t target = simulate(estimator, bandwidth, rtt, 10.0);
+    check(static_cast<double>(target) >= bdp, "fast link: target reaches the bandwidth-delay product (got " +
+                                                  std::to_string(target) + ")");
+    check(static_cast<double>(target) <= 2.5 * bdp, "fast link: target stays near 2x BDP (got " +
+                                                        std::to_string(target) + ")");
+}
+
+void test_slow_link_shrinks()
+{
+    // 300 KB/s × 100 ms：带宽时延积不到 2 个 block，目标降到下限
+    PipelineDepthEstimator estimator(default_pipeline_depth);
+    size_t target = simulate(estimator, 300e3, 0.1, 10.0);
+    check(target == min_pipeline_depth, "slow link: target drops to the minimum (got " + std::to_string(target) + ")");
+}
+
+void test_reqq_limit()
+{
+    PipelineDepthEstimator estimator(default_pipeline_depth);
+    estimator.set_limit(8);
+    check(estimator.target() == 8, "set_limit lowers the current target");
+    size_t target = simulate(estimator, 8e6, 0.1, 5.0);
+    check(target == 8, "fast link: target capped by reqq (got " + std::to_string(target) + ")");
+
+    PipelineDepthEstimator tiny(default_pipeline_depth);
+    tiny.set_limit(2);
+    check(simulate(tiny, 300e3, 0.1, 5.0) == 2, "reqq below the minimum depth is honoured");
+
+    PipelineDepthEstimator huge(default_pipeline_depth);
+    huge.set_limit(100000);
+    size_t huge_target = simulate(huge, 1e9, 0.2, 20.0);
+    check(huge_target == max_pipeline_depth,
+          "target never exceeds max_pipeline_depth (got " + std::to_string(huge_target) + ")");
+}
+
+} // namespace
+
+int main()
+{
+    test_initial_depth();
+    test_fast_link_grows();
+    test_slow_link_shrinks();
+    test_reqq_limit();
+
+    return check_result("pipeline depth");
+}
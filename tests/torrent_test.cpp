@@ -0,0 +1,89 @@
+/**
+ * @file torrent_test.cpp
+ * @brief TorrentMeta / InfoDict 字段校验的回归检查
+ */
+
+#include <string>
+#include <cstdint>
+
+#include "torrent.hpp"
+#include "check.hpp"
+
+namespace
+{
+
+std::string info_dict(const std::string& piece_length, const std::string& pieces)
+{
+    return "d6:lengthi100e4:name1:a12:piece length" + piece_length + "6:pieces" + std::to_string(pieces.size()) + ":" +
+           pieces + "e";
+}
+
+std::string torrent(const std::string& info)
+{
+    return "d8:announce9:http://x/4:info" + info + "e";
+}
+
+void test_valid()
+{
+    check_no_throw([] {
+        TorrentMeta meta = TorrentMeta::parse(torrent(info_dict("i16384e", std::string(40, 'x'))));
+        check(meta.info.piece_length == 16384, "piece length parsed");
+        check(meta.info.pieces.size() == 40, "pieces parsed");
+        check(meta.info.total_length() == 100, "length parsed");
+    }, "valid torrent");
+}
+
+void test_piece_length()
+{
+    for (const char* bad : {"i0e", "i-16384e"})
+    {
+        check_throws([&] { (void)TorrentMeta::parse(torrent(info_dict(bad, std::string(20, 'x')))); },
+                     "Invalid torrent field: piece length", std::string("TorrentMeta rejects piece length ") + bad);
+        check_throws([&] { (void)InfoDict::parse(info_dict(bad, std::string(20, 'x'))); },
+                     "Invalid torrent field: piece length", std::string("InfoDict rejects piece length ") + bad);
+    }
+    check_throws([] { (void)InfoDict::parse("d6:lengthi100e4:name1:a6:pieces20:" + std::string(20, 'x') + "e"); },
+                 "Missing torrent field: piece length", "missing piece length");
+}
+
+void test_pieces_length()
+{
+    for (size_t size : {1, 19, 21, 39})
+    {
+        check_throws([&] { (void)InfoDict::parse(info_dict("i16384e", std::string(size, 'x'))); },
+                     "Invalid torrent field: pieces", "pieces of " + std::to_string(size) + " bytes");
+    }
+    check_no_throw([] { (void)InfoDict::parse(info_dict("i16384e", "")); }, "empty pieces");
+}
+
+void test_tracker()
+{
+    std::string info = info_dict("i16384e", std::string(20, 'x'));
+    std::string trackerless = "d4:info" + info + "e";
+    check_no_throw([&] {
+        TorrentMeta meta = TorrentMeta::parse(trackerless);
+        check(!meta.has_tracker(), "torrent without announce has no tracker");
+    }, "torrent without announce parses");
+    check_throws([&] { (void)TorrentMeta::parse(trackerless).tracker_url(); },
+                 "Missing torrent field: announce", "tracker_url without announce");
+
+    // TorrentMeta 的字段指向输入，输入须比它活得久
+    std::string with_list = "d13:announce-listll9:http://y/ee4:info" + info + "e";
+    TorrentMeta meta = TorrentMeta::parse(with_list);
+    check(meta.has_tracker() && meta.tracker_url() == "http://y/", "announce-list used as tracker");
+    std::string empty_tier = "d13:announce-listllee4:info" + info + "e";
+    meta = TorrentMeta::parse(empty_tier);
+    check(!meta.has_tracker(), "empty announce-list tier is no tracker");
+}
+
+} // namespace
+
+int main()
+{
+    test_valid();
+    test_piece_length();
+    test_pieces_length();
+    test_tracker();
+
+    return check_result("torrent");
+}